@@ -0,0 +1,467 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace differ;
+
+/**
+ * Applies the specified edit @a operations to @a oldList, and returns @c true if the result
+ * is equal to @a newList. Out of range operations count as a mismatch.
+ */
+template <typename Container>
+static bool apply(const Container &oldList, const Container &newList, const std::vector<EditOperation> &operations)
+{
+    using Item = typename Container::value_type;
+
+    std::vector<Item> list(oldList.begin(), oldList.end());
+    const qsizetype newSize = newList.size();
+
+    for (const EditOperation &operation : operations) {
+        if (auto insertOperation = std::get_if<InsertOperation>(&operation)) {
+            const qsizetype index = insertOperation->index;
+            const qsizetype offset = insertOperation->offset;
+            const qsizetype count = insertOperation->count;
+            if (count < 1 || index < 0 || index > qsizetype(list.size()) || offset < 0 || offset + count > newSize) {
+                return false;
+            }
+            list.insert(list.begin() + index, newList.begin() + offset, newList.begin() + offset + count);
+        } else if (auto removeOperation = std::get_if<RemoveOperation>(&operation)) {
+            const qsizetype offset = removeOperation->offset;
+            const qsizetype count = removeOperation->count;
+            if (count < 1 || offset < 0 || offset + count > qsizetype(list.size())) {
+                return false;
+            }
+            list.erase(list.begin() + offset, list.begin() + offset + count);
+        } else if (auto moveOperation = std::get_if<MoveOperation>(&operation)) {
+            const qsizetype from = moveOperation->from;
+            const qsizetype count = moveOperation->count;
+            if (count < 1 || from < 0 || from + count > qsizetype(list.size())) {
+                return false;
+            }
+            const std::vector<Item> items(list.begin() + from, list.begin() + from + count);
+            list.erase(list.begin() + from, list.begin() + from + count);
+
+            const qsizetype to = moveOperation->to;
+            if (to < 0 || to > qsizetype(list.size())) {
+                return false;
+            }
+            list.insert(list.begin() + to, items.begin(), items.end());
+        }
+    }
+
+    return std::equal(list.begin(), list.end(), newList.begin(), newList.end());
+}
+
+/**
+ * Returns @c true if @a a and @a b are the same lists of edit operations.
+ */
+static bool equal(const std::vector<EditOperation> &a, const std::vector<EditOperation> &b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const EditOperation &x, const EditOperation &y) {
+        if (x.index() != y.index()) {
+            return false;
+        }
+        if (auto insertOperation = std::get_if<InsertOperation>(&x)) {
+            const InsertOperation &other = std::get<InsertOperation>(y);
+            return insertOperation->index == other.index && insertOperation->offset == other.offset && insertOperation->count == other.count;
+        } else if (auto removeOperation = std::get_if<RemoveOperation>(&x)) {
+            const RemoveOperation &other = std::get<RemoveOperation>(y);
+            return removeOperation->offset == other.offset && removeOperation->count == other.count;
+        } else {
+            const MoveOperation &moveOperation = std::get<MoveOperation>(x);
+            const MoveOperation &other = std::get<MoveOperation>(y);
+            return moveOperation.from == other.from && moveOperation.to == other.to && moveOperation.count == other.count;
+        }
+    });
+}
+
+/**
+ * Returns the number of items inserted and removed by the specified @a operations.
+ */
+static qsizetype cost(const std::vector<EditOperation> &operations)
+{
+    qsizetype result = 0;
+    for (const EditOperation &operation : operations) {
+        if (auto insertOperation = std::get_if<InsertOperation>(&operation)) {
+            result += insertOperation->count;
+        } else if (auto removeOperation = std::get_if<RemoveOperation>(&operation)) {
+            result += removeOperation->count;
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns the number of insertions and removals of the shortest edit script, computed with
+ * the textbook dynamic programming algorithm for the longest common subsequence.
+ */
+template <typename Container>
+static qsizetype referenceDistance(const Container &oldList, const Container &newList)
+{
+    const qsizetype oldSize = oldList.size();
+    const qsizetype newSize = newList.size();
+
+    // Row x holds the lengths of the LCS of the first x old items and every prefix of the
+    // new list, only the previous row is kept.
+    std::vector<qsizetype> previous(newSize + 1, 0);
+    std::vector<qsizetype> current(newSize + 1, 0);
+    for (qsizetype x = 1; x <= oldSize; ++x) {
+        for (qsizetype y = 1; y <= newSize; ++y) {
+            if (oldList[x - 1] == newList[y - 1]) {
+                current[y] = previous[y - 1] + 1;
+            } else {
+                current[y] = std::max(previous[y], current[y - 1]);
+            }
+        }
+        std::swap(previous, current);
+    }
+
+    return oldSize + newSize - 2 * previous[newSize];
+}
+
+struct Option
+{
+    DiffOptions options;
+    const char *name;
+    bool minimal; ///< Whether the shortest edit script is guaranteed.
+};
+
+static const Option options[] = {
+    {DiffOptions(), "none", true},
+    {DiffOption::InternItems, "InternItems", true},
+    {DiffOption::DiscardConfusingItems, "DiscardConfusingItems", false},
+    {DiffOption::LimitCost, "LimitCost", false},
+    {DiffOption::PatienceDiff, "PatienceDiff", false},
+    {DiffOption::HistogramDiff, "HistogramDiff", false},
+    {DiffOption::WuDiff, "WuDiff", true},
+    {DiffOption::BitParallelDiff, "BitParallelDiff", true},
+    {DiffOption::HuntSzymanskiDiff, "HuntSzymanskiDiff", true},
+    {DiffOption::Parallel, "Parallel", true},
+};
+
+static int failures = 0;
+
+/**
+ * Diffs @a oldList and @a newList with every option, with and without move detection, and
+ * reports the scripts that don't turn the old list into the new one, or that don't survive
+ * being encoded as an EditScript and decoded again.
+ */
+template <typename Container>
+static void check(DiffWorkspace &workspace, const Container &oldList, const Container &newList)
+{
+    EditScript script;
+    for (const Option &option : options) {
+        for (const DiffOptions moves : {DiffOptions(), DiffOptions(DiffOption::DetectMoves)}) {
+            const std::vector<EditOperation> &operations = diff(workspace, oldList, newList, option.options | moves);
+
+            script.clear();
+            for (const EditOperation &operation : operations) {
+                script.append(operation);
+            }
+            const std::vector<EditOperation> decoded(script.begin(), script.end());
+
+            if (apply(oldList, newList, operations) && qsizetype(operations.size()) == script.size() && equal(decoded, operations)) {
+                continue;
+            }
+
+            if (failures++ < 10) {
+                std::fprintf(stderr, "FAIL: %s%s, %zu -> %zu items\n", option.name, moves ? " | DetectMoves" : "",
+                             size_t(oldList.size()), size_t(newList.size()));
+            }
+        }
+    }
+}
+
+/**
+ * Checks that the algorithms that promise the shortest edit script find one as short as
+ * the reference, and that the distance functions and DiffRange agree with it. The lists
+ * must be small, as the reference takes O(NM) time.
+ */
+template <typename Container>
+static void checkMinimal(DiffWorkspace &workspace, const Container &oldList, const Container &newList)
+{
+    const qsizetype expected = referenceDistance(oldList, newList);
+    const qsizetype size = qsizetype(oldList.size()) + qsizetype(newList.size());
+
+    const auto fail = [&](const char *what, qsizetype distance) {
+        if (failures++ < 10) {
+            std::fprintf(stderr, "FAIL: %s gives %zd edits instead of %zd, %zu -> %zu items\n", what, size_t(distance), size_t(expected),
+                         size_t(oldList.size()), size_t(newList.size()));
+        }
+    };
+
+    for (const Option &option : options) {
+        if (option.minimal) {
+            const qsizetype distance = cost(diff(workspace, oldList, newList, option.options));
+            if (distance != expected) {
+                fail(option.name, distance);
+            }
+        }
+    }
+
+    if (const qsizetype distance = editDistance(oldList, newList); distance != expected) {
+        fail("editDistance()", distance);
+    }
+    if (similarity(oldList, newList) != (size ? 1 - qreal(expected) / size : 1)) {
+        fail("similarity()", expected);
+    }
+    if (!withinDistance(oldList, newList, expected) || withinDistance(oldList, newList, expected - 1)) {
+        fail("withinDistance()", expected);
+    }
+
+    std::vector<EditOperation> lazy;
+    for (const EditOperation &operation : DiffRange<Container>(oldList, newList)) {
+        lazy.push_back(operation);
+    }
+    if (!apply(oldList, newList, lazy) || cost(lazy) != expected) {
+        fail("DiffRange", cost(lazy));
+    }
+}
+
+/**
+ * Returns a copy of @a list with @a edits random insertions, removals and moves of single
+ * items drawn from an alphabet of @a alphabet symbols.
+ */
+template <typename Container>
+static Container mutate(std::mt19937 &random, const Container &list, int edits, int alphabet)
+{
+    Container result = list;
+    for (int i = 0; i < edits; ++i) {
+        const int kind = random() % 3;
+        if (kind == 0 || result.empty()) {
+            result.insert(result.begin() + random() % (result.size() + 1), 'a' + random() % alphabet);
+        } else if (kind == 1) {
+            result.erase(result.begin() + random() % result.size());
+        } else {
+            const auto item = result[random() % result.size()];
+            result.erase(result.begin() + random() % result.size());
+            result.insert(result.begin() + random() % (result.size() + 1), item);
+        }
+    }
+    return result;
+}
+
+template <typename Container>
+static Container generate(std::mt19937 &random, qsizetype size, int alphabet)
+{
+    Container result(size, 'a');
+    for (auto &item : result) {
+        item = 'a' + random() % alphabet;
+    }
+    return result;
+}
+
+template <typename Container>
+static void checkRandom(DiffWorkspace &workspace, std::mt19937 &random, qsizetype maxSize, int iterations)
+{
+    for (int i = 0; i < iterations; ++i) {
+        const int alphabet = 1 + random() % 26;
+        const Container oldList = generate<Container>(random, random() % maxSize, alphabet);
+
+        // Either an unrelated list, or a few edits away from the old one.
+        const Container newList = random() % 2 ? generate<Container>(random, random() % maxSize, alphabet)
+                                               : mutate(random, oldList, 1 + random() % (1 + maxSize / 8), alphabet);
+        check(workspace, oldList, newList);
+        checkMinimal(workspace, oldList, newList);
+    }
+}
+
+/**
+ * Checks that diffBatch() and DiffBaseline produce the same edit operations as diff() for
+ * every pair, with and without spreading the pairs over several threads.
+ */
+static void checkBatches(std::mt19937 &random)
+{
+    DiffWorkspace workspace;
+    workspace.setThreadCount(4);
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    std::vector<std::string> newLists;
+    const std::string baseline = generate<std::string>(random, 60, 8);
+    for (int i = 0; i < 200; ++i) {
+        const std::string oldList = generate<std::string>(random, random() % 60, 8);
+        pairs.emplace_back(oldList, mutate(random, oldList, random() % 8, 8));
+        newLists.push_back(mutate(random, baseline, random() % 12, 8));
+    }
+
+    const DiffBaseline<std::string> base(baseline);
+    for (const Option &option : options) {
+        for (const DiffOptions extra : {DiffOptions(), DiffOptions(DiffOption::DetectMoves), DiffOption::Parallel | DiffOption::DetectMoves}) {
+            const DiffOptions diffOptions = option.options | extra;
+
+            const DiffBatch &batch = diffBatch(workspace, pairs, diffOptions);
+            for (qsizetype i = 0; i < qsizetype(pairs.size()); ++i) {
+                const std::vector<EditOperation> operations(batch[i].begin(), batch[i].end());
+                if (!equal(operations, diff(pairs[i].first, pairs[i].second, diffOptions))) {
+                    if (failures++ < 10) {
+                        std::fprintf(stderr, "FAIL: diffBatch() differs from diff() with %s\n", option.name);
+                    }
+                    break;
+                }
+            }
+
+            for (const std::string &newList : newLists) {
+                if (!equal(base.diff(workspace, newList, diffOptions), diff(baseline, newList, diffOptions))) {
+                    if (failures++ < 10) {
+                        std::fprintf(stderr, "FAIL: DiffBaseline::diff() differs from diff() with %s\n", option.name);
+                    }
+                    break;
+                }
+            }
+
+            const DiffBatch &baselineBatch = base.diffBatch(workspace, newLists, diffOptions);
+            for (qsizetype i = 0; i < qsizetype(newLists.size()); ++i) {
+                const std::vector<EditOperation> operations(baselineBatch[i].begin(), baselineBatch[i].end());
+                if (!equal(operations, diff(baseline, newLists[i], diffOptions))) {
+                    if (failures++ < 10) {
+                        std::fprintf(stderr, "FAIL: DiffBaseline::diffBatch() differs from diff() with %s\n", option.name);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Diffs lists that are thousands of edits apart with DiffOption::Parallel. The middle snake
+ * search of the first slice runs past the round at which its backward half is moved to a
+ * helper thread, so the concurrent search must still find the shortest edit script.
+ */
+static void checkConcurrentSearch(std::mt19937 &random)
+{
+    DiffWorkspace workspace;
+    workspace.setThreadCount(4);
+
+    // Replacing items keeps the sizes equal, so that no other algorithm is chosen.
+    const std::vector<int> oldList = generate<std::vector<int>>(random, 30000, 1000000);
+    std::vector<int> newList = oldList;
+    for (int i = 0; i < 3000; ++i) {
+        newList[random() % newList.size()] = -1 - int(random() % 1000000);
+    }
+
+    const qsizetype distance = editDistance(oldList, newList);
+    const std::vector<EditOperation> &operations = diff(workspace, oldList, newList, DiffOption::Parallel);
+    if (distance <= 2 * 1024 || cost(operations) != distance || !apply(oldList, newList, operations)) {
+        ++failures;
+        std::fprintf(stderr, "FAIL: the concurrent search takes %zu edits, the distance is %zu\n",
+                     size_t(cost(operations)), size_t(distance));
+    }
+}
+
+/**
+ * Moves a block of 500 rows in a list of 3000 rows, where every @a spacing row is empty, and
+ * checks that it's detected as a single move. The block starts and ends next to an empty row
+ * at most, so the removal and the insertion found by the diff may be rotated against each
+ * other and must be aligned.
+ */
+static void checkMovedBlock(DiffWorkspace &workspace, int spacing, bool forward)
+{
+    std::vector<int> oldList(3000);
+    for (int i = 0; i < 3000; ++i) {
+        oldList[i] = i % spacing == 0 ? -1 : i;
+    }
+
+    const int from = forward ? 500 : 2000;
+    const int to = forward ? 1500 : 100;
+    std::vector<int> newList = oldList;
+    newList.erase(newList.begin() + from, newList.begin() + from + 500);
+    newList.insert(newList.begin() + to, oldList.begin() + from, oldList.begin() + from + 500);
+
+    const std::vector<EditOperation> operations = diff(workspace, oldList, newList, DiffOption::DetectMoves);
+    const bool single = operations.size() == 1 && std::holds_alternative<MoveOperation>(operations.front());
+    if (!single || !apply(oldList, newList, operations)) {
+        ++failures;
+        std::fprintf(stderr, "FAIL: moving a block %s with an empty row every %d rows takes %zu operations\n",
+                     forward ? "forward" : "backward", spacing, operations.size());
+    }
+}
+
+static void checkMovedBlocks(DiffWorkspace &workspace)
+{
+    for (const int spacing : {2, 3, 10, 50, 100000}) {
+        checkMovedBlock(workspace, spacing, true);
+        checkMovedBlock(workspace, spacing, false);
+    }
+}
+
+/**
+ * DiffOption::Parallel only spreads the Myers' algorithm over several threads, so it must not
+ * keep a faster algorithm from being chosen automatically. The algorithms produce different
+ * scripts, so the same script means that the same algorithm has been chosen.
+ */
+template <typename Container>
+static void checkParallelChoice(const char *name, const Container &oldList, const Container &newList, DiffOptions options)
+{
+    DiffWorkspace workspace;
+    workspace.setThreadCount(4);
+
+    const std::vector<EditOperation> expected = diff(workspace, oldList, newList, options);
+    if (!equal(diff(workspace, oldList, newList, options | DiffOption::Parallel), expected)) {
+        ++failures;
+        std::fprintf(stderr, "FAIL: Parallel doesn't choose the same algorithm for %s\n", name);
+    }
+}
+
+static void checkParallelChoices(std::mt19937 &random)
+{
+    // The sizes differ a lot, which picks the O(NP) algorithm.
+    const std::vector<int> items = generate<std::vector<int>>(random, 200000, 1000000);
+    std::vector<int> grown = items;
+    for (int i = 0; i < 20; ++i) {
+        grown.erase(grown.begin() + random() % grown.size());
+    }
+    for (int i = 0; i < 20000; ++i) {
+        grown.insert(grown.begin() + random() % (grown.size() + 1), 'a' + random() % 1000000);
+    }
+    checkParallelChoice("lists of very different sizes", items, grown, DiffOptions());
+
+    // Short lists that differ a lot, which picks the bit-parallel algorithm.
+    checkParallelChoice("short unrelated lists", generate<std::string>(random, 2000, 26), generate<std::string>(random, 2000, 26), DiffOptions());
+
+    // Interned lists with few common items, which picks the Hunt-Szymanski algorithm.
+    checkParallelChoice("lists with few common items", generate<std::vector<int>>(random, 20000, 1000000),
+                        generate<std::vector<int>>(random, 20000, 1000000), DiffOption::InternItems);
+}
+
+int main()
+{
+    std::mt19937 random(42);
+
+    DiffWorkspace workspace;
+    workspace.setThreadCount(4);
+    workspace.setCostLimit(16);
+
+    check(workspace, std::string("eeabccaa"), std::string("ebbea"));
+
+    checkRandom<std::string>(workspace, random, 40, 2000);
+    checkRandom<std::vector<int>>(workspace, random, 40, 2000);
+    checkRandom<std::vector<int>>(workspace, random, 300, 200);
+
+    // Large enough to be split between threads with DiffOption::Parallel.
+    for (int i = 0; i < 4; ++i) {
+        const std::vector<int> oldList = generate<std::vector<int>>(random, 20000 + random() % 20000, 5000);
+        check(workspace, oldList, mutate(random, oldList, 1 + random() % 200, 5000));
+    }
+
+    checkMovedBlocks(workspace);
+    checkBatches(random);
+    checkConcurrentSearch(random);
+    checkParallelChoices(random);
+
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
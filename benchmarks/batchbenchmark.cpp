@@ -0,0 +1,102 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace differ;
+
+using List = std::vector<int>;
+using Pairs = std::vector<std::pair<List, List>>;
+
+/**
+ * Returns @a count pairs of lists with 5 to 65 items each, where the new list is up to five
+ * random edits away from the old one.
+ */
+static Pairs generate(qsizetype count)
+{
+    std::mt19937 random(42);
+
+    Pairs pairs;
+    pairs.reserve(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        List oldList(5 + random() % 61);
+        for (int &item : oldList) {
+            item = random() % 16;
+        }
+
+        List newList = oldList;
+        for (int edits = random() % 6; edits > 0; --edits) {
+            if (random() % 2 || newList.empty()) {
+                newList.insert(newList.begin() + random() % (newList.size() + 1), random() % 16);
+            } else {
+                newList.erase(newList.begin() + random() % newList.size());
+            }
+        }
+
+        pairs.emplace_back(std::move(oldList), std::move(newList));
+    }
+    return pairs;
+}
+
+/**
+ * Runs @a function and prints how long it took, together with the total number of edit
+ * operations it returns, so the variants can be checked against each other.
+ */
+template <typename Function>
+static void measure(const char *name, Function function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const qsizetype operations = function();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    std::printf("%-36s %6lld ms, %lld operations\n", name, static_cast<long long>(elapsed.count()), static_cast<long long>(operations));
+}
+
+int main(int argc, char *argv[])
+{
+    const qsizetype count = argc > 1 ? std::atoll(argv[1]) : 200000;
+    const Pairs pairs = generate(count);
+
+    for (const DiffOptions options : {DiffOptions(), DiffOptions(DiffOption::DetectMoves)}) {
+        std::printf("%s\n", options ? "DetectMoves" : "No options");
+
+        measure("diff() per pair", [&]() {
+            qsizetype operations = 0;
+            for (const auto &[oldList, newList] : pairs) {
+                operations += diff(oldList, newList, options).size();
+            }
+            return operations;
+        });
+
+        measure("diff() per pair with one workspace", [&]() {
+            DiffWorkspace workspace;
+            qsizetype operations = 0;
+            for (const auto &[oldList, newList] : pairs) {
+                operations += diff(workspace, oldList, newList, options).size();
+            }
+            return operations;
+        });
+
+        measure("diffBatch()", [&]() {
+            DiffWorkspace workspace;
+            return qsizetype(diffBatch(workspace, pairs, options).operations().size());
+        });
+
+        measure("diffBatch() with Parallel", [&]() {
+            DiffWorkspace workspace;
+            return qsizetype(diffBatch(workspace, pairs, options | DiffOption::Parallel).operations().size());
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace differ;
+
+using Lines = std::vector<std::string>;
+
+/**
+ * Returns @a count lines that look like source code, i.e. lots of blank lines and braces
+ * between a few distinct statements.
+ */
+static Lines generate(std::mt19937 &random, qsizetype count)
+{
+    static const char *const common[] = {"", "{", "}", "    }", "    return true;", "    break;", "else"};
+
+    Lines lines;
+    lines.reserve(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        if (random() % 3) {
+            lines.push_back(common[random() % std::size(common)]);
+        } else {
+            lines.push_back("    value = compute(" + std::to_string(random() % 5000) + ");");
+        }
+    }
+    return lines;
+}
+
+/**
+ * Returns a copy of @a lines with @a edits random insertions and removals of blocks of up to
+ * ten lines.
+ */
+static Lines mutate(std::mt19937 &random, const Lines &lines, int edits)
+{
+    Lines result = lines;
+    for (int i = 0; i < edits; ++i) {
+        const qsizetype count = 1 + random() % 10;
+        if (random() % 2 || qsizetype(result.size()) < count) {
+            const Lines block = generate(random, count);
+            result.insert(result.begin() + random() % (result.size() + 1), block.begin(), block.end());
+        } else {
+            const qsizetype position = random() % (result.size() - count + 1);
+            result.erase(result.begin() + position, result.begin() + position + count);
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns the number of lines inserted and removed by the specified @a operations.
+ */
+static qsizetype cost(const std::vector<EditOperation> &operations)
+{
+    qsizetype result = 0;
+    for (const EditOperation &operation : operations) {
+        if (auto insertOperation = std::get_if<InsertOperation>(&operation)) {
+            result += insertOperation->count;
+        } else if (auto removeOperation = std::get_if<RemoveOperation>(&operation)) {
+            result += removeOperation->count;
+        }
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    const qsizetype count = argc > 1 ? std::atoll(argv[1]) : 200000;
+
+    std::mt19937 random(42);
+    const Lines oldLines = generate(random, count);
+
+    struct Option
+    {
+        DiffOptions options;
+        const char *name;
+    };
+    const Option options[] = {
+        {DiffOptions(), "Myers"},
+        {DiffOption::InternItems, "Myers, interned"},
+        {DiffOption::PatienceDiff, "PatienceDiff"},
+        {DiffOption::HistogramDiff, "HistogramDiff"},
+    };
+
+    // The heuristics may produce longer scripts than the Myers' algorithm. The number of
+    // operations shows how fragmented the script is, i.e. how many hunks a viewer shows.
+    for (const int edits : {100, 1000}) {
+        const Lines newLines = mutate(random, oldLines, edits);
+        std::printf("%lld lines, %d block edits\n", static_cast<long long>(count), edits);
+
+        DiffWorkspace workspace;
+        for (const Option &option : options) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<EditOperation> &operations = diff(workspace, oldLines, newLines, option.options);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            std::printf("  %-16s %6lld ms, %6lld hunks, %6lld lines changed\n", option.name, static_cast<long long>(elapsed.count()),
+                        static_cast<long long>(operations.size()), static_cast<long long>(cost(operations)));
+        }
+    }
+
+    return 0;
+}
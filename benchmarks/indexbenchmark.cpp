@@ -0,0 +1,92 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace differ;
+
+using List = std::vector<int>;
+
+/**
+ * Returns a list of @a size random items and a copy of it with @a edits random insertions
+ * and removals.
+ */
+static std::pair<List, List> generate(qsizetype size, int edits)
+{
+    std::mt19937 random(42);
+
+    List oldList(size);
+    for (int &item : oldList) {
+        item = random() % 100000;
+    }
+
+    List newList = oldList;
+    for (int i = 0; i < edits; ++i) {
+        if (random() % 2) {
+            newList.insert(newList.begin() + random() % (newList.size() + 1), random() % 100000);
+        } else {
+            newList.erase(newList.begin() + random() % newList.size());
+        }
+    }
+
+    return {std::move(oldList), std::move(newList)};
+}
+
+/**
+ * Diffs the lists @a iterations times with the engine instantiated for the index type of
+ * @a buffers, and prints the time per diff and the size of the diagonal arrays that the
+ * middle snake search walks over.
+ */
+template <typename Index>
+static void measure(const char *name, Private::Buffers<Index> &buffers, const List &oldList, const List &newList, int iterations)
+{
+    qsizetype operations = 0;
+    const auto sink = [&operations](const EditOperation &) {
+        ++operations;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        operations = 0;
+        Private::diff(buffers, oldList, newList, DiffOptions(), 0, 1, sink);
+    }
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start) / iterations;
+
+    // The forward and the backward search store one value per diagonal each, and the first
+    // search goes up to half the distance in either direction.
+    const qsizetype distance = editDistance(oldList, newList);
+    const qsizetype diagonalBytes = 2 * (distance + 1) * qsizetype(sizeof(Index));
+
+    std::printf("  %-10s %10.2f ms %10lld KiB of diagonals, %lld operations\n", name, elapsed.count(),
+                static_cast<long long>(diagonalBytes / 1024), static_cast<long long>(operations));
+}
+
+int main(int argc, char *argv[])
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+
+    // Both engines get the same inputs. diff() picks the 32-bit one for all of them. Note
+    // that the 32-bit engine also sweeps eight diagonals at a time if AVX2 is available, and
+    // that the cache misses can be counted with e.g. perf stat -e cache-misses.
+    for (const auto &[size, edits] : {std::pair(100000, 1000), std::pair(1000000, 2000), std::pair(1000000, 20000)}) {
+        const auto [oldList, newList] = generate(size, edits);
+        std::printf("%d items, %d edits\n", size, edits);
+
+        Private::Buffers<qint32> narrow;
+        measure("32-bit", narrow, oldList, newList, iterations);
+
+        Private::Buffers<qsizetype> wide;
+        measure("64-bit", wide, oldList, newList, iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace differ;
+
+using List = std::vector<int>;
+
+/**
+ * Runs @a function a few times and prints the shortest time it took, together with the number
+ * of edit operations it has looked at.
+ */
+template <typename Function>
+static void measure(const char *name, Function function)
+{
+    qsizetype operations = 0;
+    std::chrono::duration<double, std::milli> best = std::chrono::hours(1);
+    for (int i = 0; i < 3; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        operations = function();
+        best = std::min<std::chrono::duration<double, std::milli>>(best, std::chrono::steady_clock::now() - start);
+    }
+
+    std::printf("  %-28s %10.2f ms, %lld operations\n", name, best.count(), static_cast<long long>(operations));
+}
+
+int main(int argc, char *argv[])
+{
+    const qsizetype size = argc > 1 ? std::atoll(argv[1]) : 1000000;
+
+    std::mt19937 random(42);
+    List oldList(size);
+    for (int &item : oldList) {
+        item = random() % 100000;
+    }
+
+    for (const int edits : {2000, 20000}) {
+        List newList = oldList;
+        for (int i = 0; i < edits; ++i) {
+            if (random() % 2) {
+                newList.insert(newList.begin() + random() % (newList.size() + 1), random() % 100000);
+            } else {
+                newList.erase(newList.begin() + random() % newList.size());
+            }
+        }
+        std::printf("%lld items, %d edits\n", static_cast<long long>(size), edits);
+
+        // A consumer that shows the first few hunks stops iterating after them. Reaching the
+        // first operation still takes the middle snake search of the whole lists and of every
+        // first half after it, which is the larger part of the total cost.
+        for (const qsizetype wanted : {1, 50}) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "DiffRange, first %lld", static_cast<long long>(wanted));
+            measure(name, [&]() {
+                qsizetype operations = 0;
+                for ([[maybe_unused]] const EditOperation &operation : DiffRange<List>(oldList, newList)) {
+                    if (++operations == wanted) {
+                        break;
+                    }
+                }
+                return operations;
+            });
+        }
+
+        measure("DiffRange, all", [&]() {
+            qsizetype operations = 0;
+            for ([[maybe_unused]] const EditOperation &operation : DiffRange<List>(oldList, newList)) {
+                ++operations;
+            }
+            return operations;
+        });
+
+        // The sink of diff() sees the first operation as soon as the first snake is found, but
+        // diff() only returns once the whole script has been computed.
+        measure("diff() with a sink", [&]() {
+            qsizetype operations = 0;
+            diff(oldList, newList, [&operations](const EditOperation &) {
+                ++operations;
+            });
+            return operations;
+        });
+    }
+
+    return 0;
+}
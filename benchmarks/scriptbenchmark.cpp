@@ -0,0 +1,128 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace differ;
+
+using List = std::vector<int>;
+
+/**
+ * Runs @a function a few times and prints the shortest time it took, together with the
+ * checksum it returns, so the variants can be checked against each other.
+ */
+template <typename Function>
+static void measure(const char *name, Function function)
+{
+    qsizetype checksum = 0;
+    std::chrono::duration<double, std::milli> best = std::chrono::hours(1);
+    for (int i = 0; i < 3; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        checksum = function();
+        best = std::min<std::chrono::duration<double, std::milli>>(best, std::chrono::steady_clock::now() - start);
+    }
+
+    std::printf("  %-28s %10.2f ms, checksum %lld\n", name, best.count(), static_cast<long long>(checksum));
+}
+
+/**
+ * The Checksum struct sums up the counts of the operations it's called with. It stands in for
+ * a consumer that has to look at every operation.
+ */
+struct Checksum
+{
+    void operator()(const InsertOperation &operation)
+    {
+        sum += operation.count;
+    }
+    void operator()(const RemoveOperation &operation)
+    {
+        sum += operation.count;
+    }
+    void operator()(const MoveOperation &operation)
+    {
+        sum += operation.count;
+    }
+
+    qsizetype sum = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    const qsizetype size = argc > 1 ? std::atoll(argv[1]) : 1000000;
+
+    // Every tenth item is swapped with a nearby one, which takes a removal and an insertion
+    // per item, or a move per item with move detection.
+    std::mt19937 random(42);
+    List oldList(size);
+    for (qsizetype i = 0; i < size; ++i) {
+        oldList[i] = int(i);
+    }
+    List newList = oldList;
+    for (qsizetype i = 0; i + 5 < size; i += 10) {
+        std::swap(newList[i], newList[i + 1 + random() % 5]);
+    }
+
+    // The items are unique, so the patience diff finds the script quickly. Only the cost of
+    // storing and reading the script is measured.
+    for (const DiffOptions moves : {DiffOptions(), DiffOptions(DiffOption::DetectMoves)}) {
+        const DiffOptions options = DiffOption::PatienceDiff | moves;
+        const std::vector<EditOperation> operations = diff(oldList, newList, options);
+        std::printf("%lld items, %s\n", static_cast<long long>(size), moves ? "DetectMoves" : "no options");
+
+        EditScript script;
+        for (const EditOperation &operation : operations) {
+            script.append(operation);
+        }
+        std::printf("  %lld operations: %lld KiB as EditOperation, %lld KiB as EditScript\n", static_cast<long long>(operations.size()),
+                    static_cast<long long>(operations.size() * sizeof(EditOperation) / 1024), static_cast<long long>(script.byteSize() / 1024));
+
+        std::vector<EditOperation> copy;
+        measure("appending to a vector", [&]() {
+            copy.clear();
+            for (const EditOperation &operation : operations) {
+                copy.push_back(operation);
+            }
+            return qsizetype(copy.size());
+        });
+        measure("appending to an EditScript", [&]() {
+            script.clear();
+            for (const EditOperation &operation : operations) {
+                script.append(operation);
+            }
+            return script.size();
+        });
+
+        measure("reading the vector", [&]() {
+            Checksum checksum;
+            for (const EditOperation &operation : operations) {
+                std::visit(checksum, operation);
+            }
+            return checksum.sum;
+        });
+        measure("EditScript iterator", [&]() {
+            Checksum checksum;
+            for (const EditOperation &operation : script) {
+                std::visit(checksum, operation);
+            }
+            return checksum.sum;
+        });
+        measure("EditScript::visit()", [&]() {
+            Checksum checksum;
+            script.visit(checksum);
+            return checksum.sum;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+    SPDX-FileCopyrightText: 2021 Vlad Zahorodnii <vlad.zahorodnii@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.1-or-later
+*/
+
+#include "differ.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace differ;
+
+static std::atomic<qsizetype> allocations(0);
+
+// The replacements are not inlined, so that the compiler doesn't mistake the memory freed by
+// them for memory that comes from the built-in operator new.
+[[gnu::noinline]] void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+using List = std::vector<int>;
+using Pairs = std::vector<std::pair<List, List>>;
+
+/**
+ * Returns @a count pairs of lists with about 2000 items each, where the new list is a few
+ * dozen random edits away from the old one, including a moved block.
+ */
+static Pairs generate(int count)
+{
+    std::mt19937 random(42);
+
+    Pairs pairs;
+    for (int i = 0; i < count; ++i) {
+        List oldList(1900 + random() % 200);
+        for (int &item : oldList) {
+            item = random() % 500;
+        }
+
+        List newList = oldList;
+        for (int edits = 10 + random() % 40; edits > 0; --edits) {
+            if (random() % 2) {
+                newList.insert(newList.begin() + random() % (newList.size() + 1), random() % 500);
+            } else {
+                newList.erase(newList.begin() + random() % newList.size());
+            }
+        }
+
+        const qsizetype from = random() % (newList.size() - 100);
+        const List block(newList.begin() + from, newList.begin() + from + 50);
+        newList.erase(newList.begin() + from, newList.begin() + from + 50);
+        newList.insert(newList.begin() + random() % (newList.size() + 1), block.begin(), block.end());
+
+        pairs.emplace_back(std::move(oldList), std::move(newList));
+    }
+    return pairs;
+}
+
+struct Option
+{
+    DiffOptions options;
+    const char *name;
+};
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? std::atoi(argv[1]) : 50;
+    const Pairs pairs = generate(count);
+
+    const Option options[] = {
+        {DiffOptions(), "none"},
+        {DiffOption::DetectMoves, "DetectMoves"},
+        {DiffOption::InternItems, "InternItems"},
+        {DiffOption::DiscardConfusingItems, "DiscardConfusingItems"},
+        {DiffOption::LimitCost, "LimitCost"},
+        {DiffOption::PatienceDiff, "PatienceDiff"},
+        {DiffOption::HistogramDiff, "HistogramDiff"},
+        {DiffOption::WuDiff, "WuDiff"},
+        {DiffOption::BitParallelDiff, "BitParallelDiff"},
+        {DiffOption::HuntSzymanskiDiff, "HuntSzymanskiDiff"},
+        {DiffOption::InternItems | DiffOption::DetectMoves, "InternItems | DetectMoves"},
+    };
+
+    std::printf("%-28s %10s %14s %14s\n", "", "allocations", "fresh (us)", "reused (us)");
+
+    for (const Option &option : options) {
+        // A new workspace for every diff, as with the diff() overload without a workspace.
+        const auto freshStart = std::chrono::steady_clock::now();
+        for (const auto &[oldList, newList] : pairs) {
+            DiffWorkspace workspace;
+            diff(workspace, oldList, newList, option.options);
+        }
+        const auto fresh = std::chrono::steady_clock::now() - freshStart;
+
+        // One workspace for all diffs. The first round grows the buffers, the second one is
+        // the steady state, which should not allocate at all.
+        DiffWorkspace workspace;
+        for (const auto &[oldList, newList] : pairs) {
+            diff(workspace, oldList, newList, option.options);
+        }
+
+        const qsizetype allocationsBefore = allocations.load();
+        const auto reusedStart = std::chrono::steady_clock::now();
+        for (const auto &[oldList, newList] : pairs) {
+            diff(workspace, oldList, newList, option.options);
+        }
+        const auto reused = std::chrono::steady_clock::now() - reusedStart;
+        const qsizetype steadyAllocations = allocations.load() - allocationsBefore;
+
+        const auto perDiff = [count](std::chrono::steady_clock::duration duration) {
+            return std::chrono::duration<double, std::micro>(duration).count() / count;
+        };
+        std::printf("%-28s %10lld %14.1f %14.1f\n", option.name, static_cast<long long>(steadyAllocations), perDiff(fresh), perDiff(reused));
+    }
+
+    return 0;
+}
@@ -7,12 +7,33 @@
 #pragma once
 
 #include <QtGlobal>
+#include <QtAlgorithms>
+#include <QHashFunctions>
 
 #include <algorithm>
-#include <stack>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
+#if defined(Q_PROCESSOR_X86)
+#include <immintrin.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+class QChar;
+QT_END_NAMESPACE
+
 namespace differ
 {
 
@@ -20,8 +41,10 @@ namespace Private
 {
 
 /**
- * The Snake struct represents a partial match between two lists.
+ * The Snake struct represents a partial match between two lists. The @c Index type is
+ * either qint32 or qsizetype, depending on the size of the lists.
  */
+template <typename Index>
 struct Snake
 {
     /**
@@ -40,15 +63,16 @@ struct Snake
         return x1 != x2 && y1 == y2;
     }
 
-    qsizetype x1; ///< start position in the old list
-    qsizetype x2; ///< end position in the old list
-    qsizetype y1; ///< start position in the new list
-    qsizetype y2; ///< end position in the new list
+    Index x1; ///< start position in the old list
+    Index x2; ///< end position in the old list
+    Index y1; ///< start position in the new list
+    Index y2; ///< end position in the new list
 };
 
 /**
  * The Slice struct represents a range in two lists.
  */
+template <typename Index>
 struct Slice
 {
     bool isNull() const
@@ -56,307 +80,4228 @@ struct Slice
         return (x2 - x1) == 0 && (y2 - y1) == 0;
     }
 
-    qsizetype x1; ///< start position in the old list
-    qsizetype x2; ///< end position in the old list
-    qsizetype y1; /// start position in the new list
-    qsizetype y2; ///< end position in the new list
+    Index x1; ///< start position in the old list
+    Index x2; ///< end position in the old list
+    Index y1; /// start position in the new list
+    Index y2; ///< end position in the new list
 };
 
 /**
- * Finds the middle snake in the specified @a slice. For more details, please see
- * the Myers' paper for more details.
+ * The Diagonals class stores one value per diagonal of the edit graph, e.g. the furthest
+ * reaching x or y coordinate on that diagonal. Diagonals are indexed from -radius to radius,
+ * where radius only grows as far as the middle snake search actually goes. This way, the
+ * memory usage depends on the edit distance rather than on the size of the lists.
  */
-template <typename Container>
-static Snake diffPartial(const Slice &slice, const Container &src, const Container &dst,
-                         qsizetype *forward, qsizetype *backward, qsizetype offset)
+template <typename Index>
+class Diagonals
 {
-    const qsizetype oldSize = slice.x2 - slice.x1;
-    const qsizetype newSize = slice.y2 - slice.y1;
+public:
+    Index &operator[](Index k)
+    {
+        return m_data[m_radius + k];
+    }
 
-    if (oldSize < 1 || newSize < 1) {
-        return Snake{.x1 = 0, .x2 = oldSize, .y1 = 0, .y2 = newSize};
+    /**
+     * Returns a pointer to the value of the diagonal 0.
+     */
+    Index *center()
+    {
+        return m_data.data() + m_radius;
     }
 
-    const qsizetype delta = oldSize - newSize;
-    const qsizetype max = (oldSize + newSize + 1) / 2;
-    const bool front = (delta % 2) != 0;
+    /**
+     * Makes sure that diagonals in range [-@a radius, @a radius] can be accessed. Values
+     * that have been stored previously are preserved.
+     */
+    void reserve(qsizetype radius)
+    {
+        if (radius <= m_radius) {
+            return;
+        }
 
-    forward[offset + 1] = 0;
-    backward[offset + 1] = newSize;
+        const qsizetype newRadius = std::max(radius, 2 * m_radius);
+        std::vector<Index> data(2 * newRadius + 1);
+        std::copy(m_data.cbegin(), m_data.cend(), data.begin() + (newRadius - m_radius));
 
-    for (qsizetype d = 0; d <= max; ++d) {
-        for (qsizetype k = -d; k <= d; k += 2) {
-            // Decide whether to go downward or rightward. Moving rightward means removing
-            // an item from the old list; moving downward corresponds to inserting.
-            qsizetype x, ox;
-            if (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1])) {
-                ox = forward[offset + k + 1];
-                x = ox;
-            } else {
-                ox = forward[offset + k - 1];
-                x = ox + 1;
-            }
+        m_data.swap(data);
+        m_radius = newRadius;
+    }
 
-            // k is defined as difference between x and y.
-            qsizetype y = x - k;
-            const qsizetype oy = (d == 0 || x != ox) ? y : y - 1;
+private:
+    std::vector<Index> m_data;
+    qsizetype m_radius = -1;
+};
 
-            // Move along the diagonals, if possible. Moving along diagonals corresponds to
-            // preserving items in the old list.
-            while (x < oldSize && y < newSize && src[slice.x1 + x] == dst[slice.y1 + y]) {
-                ++x;
-                ++y;
-            }
+/**
+ * The IsBitwiseComparable type trait indicates whether two items of type @c T are equal
+ * if and only if their object representations are equal.
+ */
+template <typename T>
+struct IsBitwiseComparable : std::bool_constant<std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>>
+{
+};
 
-            forward[offset + k] = x;
+template <>
+struct IsBitwiseComparable<QT_PREPEND_NAMESPACE(QChar)> : std::true_type
+{
+};
 
-            const qsizetype c = k - delta;
-            if (front && c >= -d + 1 && c <= d - 1 && y >= backward[offset + c]) {
-                const qsizetype by = backward[offset + c];
-                const qsizetype bx = by + k;
+/**
+ * The HasBitwiseStorage type trait indicates whether the items of the specified container
+ * are stored contiguously and can be compared with memcmp() and alike.
+ */
+template <typename Container, typename = void>
+struct HasBitwiseStorage : std::false_type
+{
+};
 
-                if (x != bx) {
-                    return Snake{.x1 = bx, .x2 = x, .y1 = by, .y2 = y,};
-                } else {
-                    return Snake{.x1 = ox, .x2 = x, .y1 = oy, .y2 = y,};
-                }
-            }
-        }
+template <typename Container>
+struct HasBitwiseStorage<Container, std::void_t<decltype(std::data(std::declval<const Container &>()))>>
+    : IsBitwiseComparable<std::remove_cv_t<std::remove_pointer_t<decltype(std::data(std::declval<const Container &>()))>>>
+{
+};
 
-        for (qsizetype c = -d; c <= d; c += 2) {
-            // Decide whether to go leftward or upward.
-            qsizetype y, oy;
-            if (c == -d || (c != d && backward[offset + c - 1] > backward[offset + c + 1])) {
-                oy = backward[offset + c + 1];
-                y = oy;
-            } else {
-                oy = backward[offset + c - 1];
-                y = oy - 1;
-            }
+#if defined(Q_PROCESSOR_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DIFFER_HAVE_SSE2
+#if defined(__GNUC__)
+#define DIFFER_HAVE_AVX2_DISPATCH
+#endif
+#endif
 
-            // k is defined as difference between x and y.
-            const qsizetype k = c + delta;
-            qsizetype x = y + k;
-            const qsizetype ox = (d == 0 || y != oy) ? x : x + 1;
+/**
+ * Returns the number of equal bytes at the start of the two @a size byte long buffers.
+ */
+static inline size_t mismatchForwardScalar(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    while (size - matched >= 64 && std::memcmp(a + matched, b + matched, 64) == 0) {
+        matched += 64;
+    }
+    while (matched < size && a[matched] == b[matched]) {
+        ++matched;
+    }
+    return matched;
+}
 
-            // Move along the diagonals, if possible. Moving along diagonals corresponds to
-            // preserving items in the old list.
-            while (x > 0 && y > 0 && src[slice.x1 + x - 1] == dst[slice.y1 + y - 1]) {
-                --x;
-                --y;
-            }
+/**
+ * Returns the number of equal bytes at the end of the two @a size byte long buffers.
+ */
+static inline size_t mismatchBackwardScalar(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    while (size - matched >= 64 && std::memcmp(a + size - matched - 64, b + size - matched - 64, 64) == 0) {
+        matched += 64;
+    }
+    while (matched < size && a[size - matched - 1] == b[size - matched - 1]) {
+        ++matched;
+    }
+    return matched;
+}
 
-            backward[offset + c] = y;
+#if defined(DIFFER_HAVE_SSE2)
+static inline size_t mismatchForwardSse2(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    for (; size - matched >= 16; matched += 16) {
+        const __m128i lhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + matched));
+        const __m128i rhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + matched));
+        const unsigned mask = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs))) & 0xffff;
+        if (mask) {
+            return matched + qCountTrailingZeroBits(quint32(mask));
+        }
+    }
+    return matched + mismatchForwardScalar(a + matched, b + matched, size - matched);
+}
 
-            if (!front && k >= -d && k <= d && x <= forward[offset + k]) {
-                const qsizetype fx = forward[offset + k];
-                const qsizetype fy = fx - k;
+static inline size_t mismatchBackwardSse2(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    for (; size - matched >= 16; matched += 16) {
+        const __m128i lhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + size - matched - 16));
+        const __m128i rhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + size - matched - 16));
+        const unsigned mask = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs))) & 0xffff;
+        if (mask) {
+            return matched + qCountLeadingZeroBits(quint32(mask)) - 16;
+        }
+    }
+    return matched + mismatchBackwardScalar(a, b, size - matched);
+}
+#endif
 
-                if (x != fx) {
-                    return Snake{.x1 = x, .x2 = fx, .y1 = y, .y2 = fy,};
-                } else {
-                    return Snake{.x1 = x, .x2 = ox, .y1 = y, .y2 = oy,};
-                }
-            }
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2"))) static inline size_t mismatchForwardAvx2(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    for (; size - matched >= 32; matched += 32) {
+        const __m256i lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + matched));
+        const __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + matched));
+        const unsigned mask = ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lhs, rhs)));
+        if (mask) {
+            return matched + qCountTrailingZeroBits(quint32(mask));
         }
     }
+    return matched + mismatchForwardSse2(a + matched, b + matched, size - matched);
+}
 
-    Q_UNREACHABLE();
+__attribute__((target("avx2"))) static inline size_t mismatchBackwardAvx2(const unsigned char *a, const unsigned char *b, size_t size)
+{
+    size_t matched = 0;
+    for (; size - matched >= 32; matched += 32) {
+        const __m256i lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + size - matched - 32));
+        const __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + size - matched - 32));
+        const unsigned mask = ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lhs, rhs)));
+        if (mask) {
+            return matched + qCountLeadingZeroBits(quint32(mask));
+        }
+    }
+    return matched + mismatchBackwardSse2(a, b, size - matched);
 }
+#endif
 
-} // namespace Private
+using MismatchFunction = size_t (*)(const unsigned char *, const unsigned char *, size_t);
 
 /**
- * The InsertOperation type represents an insertion operation.
+ * Returns the fastest implementation of the forward (if @a forward is @c true) or backward
+ * mismatch search supported by the CPU.
  */
-struct InsertOperation
+static inline MismatchFunction resolveMismatch(bool forward)
 {
-    qsizetype index; ///< The position in the old list.
-    qsizetype offset; ///< The position in the new list.
-    qsizetype count; ///< The number of items to be inserted.
-};
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
+    if (__builtin_cpu_supports("avx2")) {
+        return forward ? mismatchForwardAvx2 : mismatchBackwardAvx2;
+    }
+#endif
+#if defined(DIFFER_HAVE_SSE2)
+    return forward ? mismatchForwardSse2 : mismatchBackwardSse2;
+#else
+    return forward ? mismatchForwardScalar : mismatchBackwardScalar;
+#endif
+}
 
 /**
- * The RemoveOperation type represents a remove operation in the old list.
+ * Returns the number of equal items at the start of the ranges [@a x, @a x + @a count) in
+ * the @a src list and [@a y, @a y + @a count) in the @a dst list.
  */
-struct RemoveOperation
+template <typename Index, typename Container>
+static Index matchForward(const Container &src, Index x, const Container &dst, Index y, Index count)
 {
-    qsizetype offset; ///< The position in the old list.
-    qsizetype count; ///< The number of items to be removed.
-};
+    if (count <= 0 || !(src[x] == dst[y])) {
+        return 0;
+    }
+
+    if constexpr (HasBitwiseStorage<Container>::value) {
+        static const MismatchFunction mismatch = resolveMismatch(true);
+        constexpr size_t itemSize = sizeof(*std::data(src));
+        const auto a = reinterpret_cast<const unsigned char *>(std::data(src) + x);
+        const auto b = reinterpret_cast<const unsigned char *>(std::data(dst) + y);
+        return mismatch(a, b, count * itemSize) / itemSize;
+    } else {
+        Index matched = 1;
+        while (matched < count && src[x + matched] == dst[y + matched]) {
+            ++matched;
+        }
+        return matched;
+    }
+}
 
 /**
- * The MoveOperation type represents a move operation in the old list.
+ * Returns the number of equal items at the end of the ranges [@a x - @a count, @a x) in
+ * the @a src list and [@a y - @a count, @a y) in the @a dst list.
  */
-struct MoveOperation
+template <typename Index, typename Container>
+static Index matchBackward(const Container &src, Index x, const Container &dst, Index y, Index count)
 {
-    qsizetype from; ///< The start position in the old list.
-    qsizetype to; /// The target position in the old list.
-    qsizetype count; ///< The number of items to be moved.
-};
+    if (count <= 0 || !(src[x - 1] == dst[y - 1])) {
+        return 0;
+    }
 
-using EditOperation = std::variant<InsertOperation, RemoveOperation, MoveOperation>;
+    if constexpr (HasBitwiseStorage<Container>::value) {
+        static const MismatchFunction mismatch = resolveMismatch(false);
+        constexpr size_t itemSize = sizeof(*std::data(src));
+        const auto a = reinterpret_cast<const unsigned char *>(std::data(src) + x - count);
+        const auto b = reinterpret_cast<const unsigned char *>(std::data(dst) + y - count);
+        return mismatch(a, b, count * itemSize) / itemSize;
+    } else {
+        Index matched = 1;
+        while (matched < count && src[x - matched - 1] == dst[y - matched - 1]) {
+            ++matched;
+        }
+        return matched;
+    }
+}
 
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
 /**
- * This enum type is used to specify additional diff options.
+ * Returns the values @a v[0], @a v[2], ..., @a v[14].
  */
-enum class DiffOption {
-    /**
-     * Find the matching insert and remove operations and interpret them as moves. Note
-     * that this may incur performance penalties.
-     */
-    DetectMoves = 0x1,
-};
-Q_DECLARE_FLAGS(DiffOptions, DiffOption)
+__attribute__((target("avx2"))) static inline __m256i loadEveryOtherAvx2(const qint32 *v)
+{
+    const __m256i evens = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(v)), evens);
+    const __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + 8)), evens);
+    return _mm256_permute2x128_si256(low, high, 0x20);
+}
 
 /**
- * This function calculates the difference between two specified lists. That's it, the
- * sequence of insert and remove operations that will transform the @a oldList into @a newList.
- *
- * If two lists are the same, an empty list will be returned. The first operation in the
- * returned list must be applied first, and the last one must be applied last.
- *
- * Internally, this function uses the Meyers' diff algorithm to calculate the difference.
+ * Runs one forward round of the middle snake search on the diagonals k, k + 2, ..., with
+ * 32-bit items, eight diagonals at a time. @a v points to the diagonal 0, @a src and @a dst
+ * point to the start of the slice. Only diagonals up to @a last are touched, and every one
+ * of them must have both neighbors. Returns the first diagonal that hasn't been processed.
  *
- * Note that move detection has O(n^2) time complexity. If the given old and new lists are
- * large and contain a lot of changes, it's recommended to move diff calculation in a thread.
+ * The diagonals of one round only depend on the diagonals of the previous round, which have
+ * the opposite parity, so the furthest reaching x and the first comparison are computed for
+ * all eight diagonals at once. Only the diagonals that start with a match follow the snake.
  */
-template <typename Container>
-static std::vector<EditOperation> diff(const Container &oldList, const Container &newList, DiffOptions options = DiffOptions())
+__attribute__((target("avx2"))) static inline qint32 sweepForwardAvx2(qint32 *v, qint32 k, qint32 last,
+                                                                      const quint32 *src, const quint32 *dst,
+                                                                      qint32 oldSize, qint32 newSize, MismatchFunction mismatch)
 {
-    std::vector<Private::Snake> snakes;
-    std::stack<Private::Slice> slices;
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i lowSpread = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i highSpread = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    const __m256i oddLanes = _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    const __m256i steps = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i oldSizes = _mm256_set1_epi32(oldSize);
+    const __m256i newSizes = _mm256_set1_epi32(newSize);
 
-    const qsizetype max = oldList.size() + newList.size() + std::abs(oldList.size() - newList.size());
-    std::vector<qsizetype> forward;
-    std::vector<qsizetype> backward;
+    alignas(32) qint32 xs[8];
+    for (; k + 14 <= last; k += 16) {
+        // The neighbors k - 1 + 2j and k + 1 + 2j of the previous round.
+        const __m256i left = loadEveryOtherAvx2(v + k - 1);
+        const __m256i right = loadEveryOtherAvx2(v + k + 1);
 
-    forward.resize(2 * max);
-    backward.resize(2 * max);
+        const __m256i x = _mm256_max_epi32(_mm256_add_epi32(left, one), right);
+        const __m256i y = _mm256_sub_epi32(x, _mm256_add_epi32(_mm256_set1_epi32(k), steps));
+        const __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(oldSizes, x), _mm256_cmpgt_epi32(newSizes, y));
+        const __m256i a = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(src), x, inside, 4);
+        const __m256i b = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(dst), y, inside, 4);
+        unsigned matches = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(a, b), inside)));
 
-    slices.push(Private::Slice{.x1 = 0, .x2 = oldList.size(), .y1 = 0, .y2 = newList.size(),});
-    while (!slices.empty()) {
-        const Private::Slice slice = slices.top();
-        slices.pop();
+        __m256i result = x;
+        if (matches) {
+            _mm256_store_si256(reinterpret_cast<__m256i *>(xs), x);
+            do {
+                const int j = qCountTrailingZeroBits(matches);
+                matches &= matches - 1;
+                const qint32 sx = xs[j];
+                const qint32 sy = sx - (k + 2 * j);
+                const size_t count = std::min(oldSize - sx, newSize - sy);
+                xs[j] += qint32(mismatch(reinterpret_cast<const unsigned char *>(src + sx),
+                                         reinterpret_cast<const unsigned char *>(dst + sy), count * 4) / 4);
+            } while (matches);
+            result = _mm256_load_si256(reinterpret_cast<const __m256i *>(xs));
+        }
 
-        Private::Snake snake = diffPartial(slice, oldList, newList, forward.data(), backward.data(), max);
+        // Store the diagonals k + 2j without touching the ones of the previous round.
+        _mm256_maskstore_epi32(v + k - 1, oddLanes, _mm256_permutevar8x32_epi32(result, lowSpread));
+        _mm256_maskstore_epi32(v + k + 7, oddLanes, _mm256_permutevar8x32_epi32(result, highSpread));
+    }
 
-        snake.x1 += slice.x1;
-        snake.x2 += slice.x1;
-        snake.y1 += slice.y1;
-        snake.y2 += slice.y1;
+    return k;
+}
 
-        if (snake.isAddition() || snake.isRemoval()) {
-            snakes.push_back(snake);
+/**
+ * Runs one backward round of the middle snake search on the diagonals c, c + 2, ..., up to
+ * @a last, eight diagonals at a time. This is the mirror image of sweepForwardAvx2(), @a v
+ * stores the furthest reaching y of every backward diagonal.
+ */
+__attribute__((target("avx2"))) static inline qint32 sweepBackwardAvx2(qint32 *v, qint32 c, qint32 last, qint32 delta,
+                                                                       const quint32 *src, const quint32 *dst, MismatchFunction mismatch)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i lowSpread = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i highSpread = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    const __m256i oddLanes = _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    const __m256i steps = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i zero = _mm256_setzero_si256();
+
+    alignas(32) qint32 ys[8];
+    for (; c + 14 <= last; c += 16) {
+        const __m256i left = loadEveryOtherAvx2(v + c - 1);
+        const __m256i right = loadEveryOtherAvx2(v + c + 1);
+
+        const __m256i y = _mm256_min_epi32(_mm256_sub_epi32(left, one), right);
+        const __m256i x = _mm256_add_epi32(y, _mm256_add_epi32(_mm256_set1_epi32(c + delta), steps));
+        const __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(x, zero), _mm256_cmpgt_epi32(y, zero));
+        const __m256i a = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(src), _mm256_sub_epi32(x, one), inside, 4);
+        const __m256i b = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(dst), _mm256_sub_epi32(y, one), inside, 4);
+        unsigned matches = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(a, b), inside)));
+
+        __m256i result = y;
+        if (matches) {
+            _mm256_store_si256(reinterpret_cast<__m256i *>(ys), y);
+            do {
+                const int j = qCountTrailingZeroBits(matches);
+                matches &= matches - 1;
+                const qint32 sy = ys[j];
+                const qint32 sx = sy + (c + delta + 2 * j);
+                const size_t count = std::min(sx, sy);
+                ys[j] -= qint32(mismatch(reinterpret_cast<const unsigned char *>(src + sx - count),
+                                         reinterpret_cast<const unsigned char *>(dst + sy - count), count * 4) / 4);
+            } while (matches);
+            result = _mm256_load_si256(reinterpret_cast<const __m256i *>(ys));
         }
 
-        const Private::Slice left {
-            .x1 = slice.x1,
-            .x2 = snake.x1,
-            .y1 = slice.y1,
-            .y2 = snake.y1,
-        };
+        _mm256_maskstore_epi32(v + c - 1, oddLanes, _mm256_permutevar8x32_epi32(result, lowSpread));
+        _mm256_maskstore_epi32(v + c + 7, oddLanes, _mm256_permutevar8x32_epi32(result, highSpread));
+    }
 
-        const Private::Slice right {
-            .x1 = snake.x2,
-            .x2 = slice.x2,
-            .y1 = snake.y2,
-            .y2 = slice.y2,
-        };
+    return c;
+}
+#endif
 
-        if (!left.isNull()) {
-            slices.push(left);
+/**
+ * Returns a split point in the specified @a slice after @a d rounds of the middle snake search
+ * have failed to find the middle snake. The split point is the furthest reaching point of either
+ * the forward or the backward search. If there is no suitable point, a null snake is returned.
+ */
+template <typename Index>
+static Snake<Index> findSplitPoint(const Slice<Index> &slice, Index d, Index delta,
+                                   Diagonals<Index> &forward, Diagonals<Index> &backward)
+{
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+
+    // The search doesn't clamp diagonals to the slice, so skip the points outside of it.
+    Index forwardBest = -1;
+    Index forwardX = 0;
+    for (Index k = -d; k <= d; k += 2) {
+        const Index x = forward[k];
+        const Index y = x - k;
+        if (x <= oldSize && y <= newSize && x + y < oldSize + newSize && x + y > forwardBest) {
+            forwardBest = x + y;
+            forwardX = x;
         }
-        if (!right.isNull()) {
-            slices.push(right);
+    }
+
+    Index backwardBest = -1;
+    Index backwardY = 0;
+    for (Index c = -d; c <= d; c += 2) {
+        const Index y = backward[c];
+        const Index x = y + c + delta;
+        if (x >= 0 && y >= 0 && x + y > 0 && oldSize + newSize - (x + y) > backwardBest) {
+            backwardBest = oldSize + newSize - (x + y);
+            backwardY = y;
         }
     }
 
-    std::sort(snakes.begin(), snakes.end(), [](const auto &a, const auto &b) {
-        return a.x1 == b.x1 ? a.y1 < b.y1 : a.x1 < b.x1;
-    });
+    if (forwardBest < 0 && backwardBest < 0) {
+        return Snake<Index>{.x1 = 0, .x2 = 0, .y1 = 0, .y2 = 0};
+    }
 
-    std::vector<EditOperation> editOperations;
-    editOperations.reserve(snakes.size());
-
-    if (!(options & DiffOption::DetectMoves)) {
-        // Traverse the snake path backwards and issue edit commands as we walk the path.
-        for (auto it = snakes.crbegin(); it != snakes.crend(); ++it) {
-            if (it->isAddition()) {
-                editOperations.emplace_back(InsertOperation{
-                    .index = it->x1,
-                    .offset = it->y1,
-                    .count = it->y2 - it->y1,
-                });
-            } else if (it->isRemoval()) {
-                editOperations.emplace_back(RemoveOperation{
-                    .offset = it->x1,
-                    .count = it->x2 - it->x1,
-                });
-            }
-        }
+    Index x;
+    Index y;
+    if (forwardBest >= backwardBest) {
+        x = forwardX;
+        y = forwardBest - forwardX;
     } else {
-        // Subdivide insert and remove operations in order to simplify move detection.
-        for (auto it = snakes.crbegin(); it != snakes.crend(); ++it) {
-            if (it->isAddition()) {
-                for (qsizetype j = 0; j < it->y2 - it->y1; ++j) {
-                    editOperations.emplace_back(InsertOperation{
-                        .index = it->x1 + j,
-                        .offset = it->y1 + j,
-                        .count = 1,
-                    });
+        y = backwardY;
+        x = oldSize + newSize - backwardBest - backwardY;
+    }
+
+    return Snake<Index>{.x1 = x, .x2 = x, .y1 = y, .y2 = y};
+}
+
+/**
+ * The MiddleSnakeSearch struct runs the rounds of the middle snake search in a slice. The
+ * forward round d only writes the diagonals of the forward paths with the same parity as d,
+ * and reads the ones with the opposite parity, and the same goes for the backward rounds.
+ */
+template <typename Index, typename Container>
+struct MiddleSnakeSearch
+{
+    /**
+     * Extends the forward paths by one edit. Returns @c true and stores the middle snake in
+     * @a snake if the forward paths overlap with the backward paths of the previous round.
+     */
+    bool forwardRound(Index d, Snake<Index> &snake) const
+    {
+        Index k = -d;
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
+        if constexpr (canSweep) {
+            if (d >= sweepRound && sweepSupported()) {
+                if (forwardStep(d, k, snake)) {
+                    return true;
                 }
-            } else if (it->isRemoval()) {
-                for (qsizetype j = 0; j < it->x2 - it->x1; ++j) {
-                    editOperations.emplace_back(RemoveOperation{
-                        .offset = it->x1 + j,
-                        .count = 1,
-                    });
+
+                static const MismatchFunction mismatch = resolveMismatch(true);
+                const Index first = k + 2;
+                k = sweepForwardAvx2(forward.center(), first, d - 2,
+                                     reinterpret_cast<const quint32 *>(std::data(src) + slice.x1),
+                                     reinterpret_cast<const quint32 *>(std::data(dst) + slice.y1),
+                                     oldSize, newSize, mismatch);
+
+                // The sweep doesn't look for the overlap. If there is one, redo the first
+                // overlapping diagonal to get the middle snake.
+                if (front) {
+                    for (Index j = first; j < k; j += 2) {
+                        const Index c = j - delta;
+                        if (c >= -d + 1 && c <= d - 1 && forward[j] - j >= backward[c]) {
+                            return forwardStep(d, j, snake);
+                        }
+                    }
                 }
             }
         }
+#endif
+        for (; k <= d; k += 2) {
+            if (forwardStep(d, k, snake)) {
+                return true;
+            }
+        }
 
-        for (int i = 0; i < editOperations.size(); ++i) {
-            if (auto insert = std::get_if<InsertOperation>(&editOperations[i])) {
-                for (int j = i + 1; j < editOperations.size(); ++j) {
-                    if (auto remove = std::get_if<RemoveOperation>(&editOperations[j])) {
-                        if (oldList[remove->offset] != newList[insert->offset]) {
-                            continue;
-                        }
-                        for (int k = i + 1; k < j; ++k) {
-                            if (auto insert = std::get_if<InsertOperation>(&editOperations[k])) {
-                                insert->index -= 1;
-                            }
-                        }
-                        editOperations[i] = MoveOperation{
-                            .from = remove->offset,
-                            .to = insert->index - 1,
-                            .count = 1,
-                        };
-                        editOperations.erase(std::next(editOperations.begin(), j));
-                        break;
-                    }
+        return false;
+    }
+
+    /**
+     * Extends the backward paths by one edit. Returns @c true and stores the middle snake in
+     * @a snake if the backward paths overlap with the forward paths of the same round.
+     */
+    bool backwardRound(Index d, Snake<Index> &snake) const
+    {
+        Index c = -d;
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
+        if constexpr (canSweep) {
+            if (d >= sweepRound && sweepSupported()) {
+                if (backwardStep(d, c, snake)) {
+                    return true;
                 }
-            } else if (auto remove = std::get_if<RemoveOperation>(&editOperations[i])) {
-                for (int j = i + 1; j < editOperations.size(); ++j) {
-                    if (auto insert = std::get_if<InsertOperation>(&editOperations[j])) {
-                        if (oldList[remove->offset] != newList[insert->offset]) {
-                            continue;
+
+                static const MismatchFunction mismatch = resolveMismatch(false);
+                const Index first = c + 2;
+                c = sweepBackwardAvx2(backward.center(), first, d - 2, delta,
+                                      reinterpret_cast<const quint32 *>(std::data(src) + slice.x1),
+                                      reinterpret_cast<const quint32 *>(std::data(dst) + slice.y1),
+                                      mismatch);
+
+                if (!front) {
+                    for (Index j = first; j < c; j += 2) {
+                        const Index k = j + delta;
+                        if (k >= -d && k <= d && backward[j] + k <= forward[k]) {
+                            return backwardStep(d, j, snake);
                         }
-                        editOperations[i] = MoveOperation{
-                            .from = remove->offset,
-                            .to = insert->index,
-                            .count = 1,
-                        };
-                        editOperations.erase(std::next(editOperations.begin(), j));
-                        break;
                     }
                 }
             }
         }
+#endif
+        for (; c <= d; c += 2) {
+            if (backwardStep(d, c, snake)) {
+                return true;
+            }
+        }
+
+        return false;
     }
 
-    return editOperations;
-}
+    /**
+     * Extends the forward path on the diagonal @a k in the round @a d.
+     */
+    bool forwardStep(Index d, Index k, Snake<Index> &snake) const
+    {
+        // Decide whether to go downward or rightward. Moving rightward means removing
+        // an item from the old list; moving downward corresponds to inserting.
+        Index x, ox;
+        if (k == -d || (k != d && forward[k - 1] < forward[k + 1])) {
+            ox = forward[k + 1];
+            x = ox;
+        } else {
+            ox = forward[k - 1];
+            x = ox + 1;
+        }
+
+        // k is defined as difference between x and y.
+        Index y = x - k;
+        const Index oy = (d == 0 || x != ox) ? y : y - 1;
+        const Index sx = x;
+        const Index sy = y;
+
+        // Move along the diagonals, if possible. Moving along diagonals corresponds to
+        // preserving items in the old list.
+        const Index forwardSnake = matchForward(src, slice.x1 + x, dst, slice.y1 + y, std::min(oldSize - x, newSize - y));
+        x += forwardSnake;
+        y += forwardSnake;
+
+        forward[k] = x;
+
+        const Index c = k - delta;
+        if (front && c >= -d + 1 && c <= d - 1 && y >= backward[c]) {
+            // The last snake of the forward path is the middle snake. If it's empty,
+            // report the edit that leads to it instead so the slice always shrinks.
+            if (x != sx) {
+                snake = Snake<Index>{.x1 = sx, .x2 = x, .y1 = sy, .y2 = y,};
+            } else {
+                snake = Snake<Index>{.x1 = ox, .x2 = x, .y1 = oy, .y2 = y,};
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Extends the backward path on the diagonal @a c in the round @a d.
+     */
+    bool backwardStep(Index d, Index c, Snake<Index> &snake) const
+    {
+        // Decide whether to go leftward or upward.
+        Index y, oy;
+        if (c == -d || (c != d && backward[c - 1] > backward[c + 1])) {
+            oy = backward[c + 1];
+            y = oy;
+        } else {
+            oy = backward[c - 1];
+            y = oy - 1;
+        }
+
+        // k is defined as difference between x and y.
+        const Index k = c + delta;
+        Index x = y + k;
+        const Index ox = (d == 0 || y != oy) ? x : x + 1;
+        const Index sx = x;
+        const Index sy = y;
+
+        // Move along the diagonals, if possible. Moving along diagonals corresponds to
+        // preserving items in the old list.
+        const Index backwardSnake = matchBackward(src, slice.x1 + x, dst, slice.y1 + y, std::min(x, y));
+        x -= backwardSnake;
+        y -= backwardSnake;
+
+        backward[c] = y;
+
+        if (!front && k >= -d && k <= d && x <= forward[k]) {
+            if (x != sx) {
+                snake = Snake<Index>{.x1 = x, .x2 = sx, .y1 = y, .y2 = sy,};
+            } else {
+                snake = Snake<Index>{.x1 = x, .x2 = ox, .y1 = y, .y2 = oy,};
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+#if defined(DIFFER_HAVE_AVX2_DISPATCH)
+    /**
+     * Whether the rounds can sweep eight diagonals at a time, i.e. the items are 32-bit
+     * values that can be compared bitwise.
+     */
+    static constexpr bool canSweep = [] {
+        if constexpr (std::is_same_v<Index, qint32> && HasBitwiseStorage<Container>::value) {
+            return sizeof(*std::data(std::declval<const Container &>())) == sizeof(quint32);
+        } else {
+            return false;
+        }
+    }();
+
+    /**
+     * The round from which the diagonals are swept. The earlier rounds are too short.
+     */
+    static constexpr Index sweepRound = 32;
+
+    static bool sweepSupported()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+    const Slice<Index> &slice;
+    const Container &src;
+    const Container &dst;
+    Diagonals<Index> &forward;
+    Diagonals<Index> &backward;
+    Index oldSize;
+    Index newSize;
+    Index delta;
+    bool front;
+};
+
+/**
+ * The round after which diffPartial() moves the backward search to a second thread if asked
+ * to. Earlier rounds are too short to be worth the synchronization.
+ */
+static constexpr qsizetype concurrentSearchRound = 1024;
+
+/**
+ * Continues the middle snake search from round @a first, running the forward rounds on the
+ * calling thread and the backward rounds on a helper thread. All rounds before @a first must
+ * have been completed.
+ *
+ * If delta is odd, only the forward rounds look for the overlap, using the backward paths of
+ * the previous round, so the forward and the backward round d run at the same time. If delta
+ * is even, only the backward rounds look for the overlap, using the forward paths of the same
+ * round, so the backward round d runs alongside the forward round d + 1. In both cases, the
+ * rounds running at the same time touch different diagonals, and the threads only meet once
+ * per round. The result is the same as the one of the sequential search.
+ */
+template <typename Index, typename Container>
+static Snake<Index> diffPartialConcurrent(const MiddleSnakeSearch<Index, Container> &search, Index first, Index max, Index costLimit)
+{
+    Diagonals<Index> &forward = search.forward;
+    Diagonals<Index> &backward = search.backward;
+
+    // The rounds are handed over to the helper by publishing their numbers. The helper
+    // publishes the number of the last round that it has finished.
+    std::atomic<qsizetype> started(first - 1);
+    std::atomic<qsizetype> finished(first - 1);
+    std::atomic<bool> stop(false);
+    Snake<Index> helperSnake;
+    bool helperFound = false;
+
+    const auto wait = [](const std::atomic<qsizetype> &counter, qsizetype round, const std::atomic<bool> *stop) {
+        while (counter.load(std::memory_order_acquire) < round) {
+            if (stop && stop->load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    };
+
+    std::thread helper([&]() {
+        for (qsizetype round = first;; ++round) {
+            if (!wait(started, round, &stop)) {
+                return;
+            }
+            helperFound = search.backwardRound(Index(round), helperSnake);
+            finished.store(round, std::memory_order_release);
+        }
+    });
+
+    Snake<Index> snake = Snake<Index>{.x1 = 0, .x2 = 0, .y1 = 0, .y2 = 0};
+    bool found = false;
+
+    // With an even delta, the forward round runs one round ahead of the backward round.
+    const Index lead = search.front ? 0 : 1;
+    if (lead) {
+        forward.reserve(first + 1);
+        search.forwardRound(first, snake);
+    }
+
+    for (Index d = first; d <= max; ++d) {
+        forward.reserve(d + lead + 1);
+        backward.reserve(d + 1);
+
+        started.store(d, std::memory_order_release);
+        found = search.forwardRound(d + lead, snake);
+        wait(finished, d, nullptr);
+
+        if (found) {
+            break;
+        }
+        if (helperFound) {
+            snake = helperSnake;
+            found = true;
+            break;
+        }
+
+        if (d >= costLimit) {
+            const Snake<Index> split = findSplitPoint(search.slice, d, search.delta, forward, backward);
+            if (split.x1 + split.y1 > 0) {
+                snake = split;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    stop.store(true, std::memory_order_release);
+    helper.join();
+
+    if (!found) {
+        Q_UNREACHABLE();
+    }
+    return snake;
+}
+
+/**
+ * Finds the middle snake in the specified @a slice. For more details, please see
+ * the Myers' paper for more details.
+ *
+ * If the middle snake hasn't been found after @a costLimit rounds, the search is abandoned
+ * and the slice is split at the furthest reaching point instead. The returned snake is
+ * empty in that case.
+ *
+ * If @a concurrent is @c true, the backward half of long searches runs on a second thread.
+ */
+template <typename Index, typename Container>
+static Snake<Index> diffPartial(const Slice<Index> &slice, const Container &src, const Container &dst,
+                                Diagonals<Index> &forward, Diagonals<Index> &backward, Index costLimit,
+                                bool concurrent = false)
+{
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+
+    if (oldSize < 1 || newSize < 1) {
+        return Snake<Index>{.x1 = 0, .x2 = oldSize, .y1 = 0, .y2 = newSize};
+    }
+
+    const Index delta = oldSize - newSize;
+    const Index max = (oldSize + newSize + 1) / 2;
+
+    const MiddleSnakeSearch<Index, Container> search{
+        .slice = slice,
+        .src = src,
+        .dst = dst,
+        .forward = forward,
+        .backward = backward,
+        .oldSize = oldSize,
+        .newSize = newSize,
+        .delta = delta,
+        .front = (delta % 2) != 0,
+    };
+
+    forward.reserve(1);
+    backward.reserve(1);
+
+    forward[1] = 0;
+    backward[1] = newSize;
+
+    Snake<Index> snake;
+    for (Index d = 0; d <= max; ++d) {
+        if (concurrent && d >= concurrentSearchRound) {
+            return diffPartialConcurrent(search, d, max, costLimit);
+        }
+
+        forward.reserve(d + 1);
+        backward.reserve(d + 1);
+
+        if (search.forwardRound(d, snake) || search.backwardRound(d, snake)) {
+            return snake;
+        }
+
+        if (d >= costLimit) {
+            const Snake<Index> split = findSplitPoint(slice, d, delta, forward, backward);
+            if (split.x1 + split.y1 > 0) {
+                return split;
+            }
+        }
+    }
+
+    Q_UNREACHABLE();
+}
+
+} // namespace Private
+
+/**
+ * The InsertOperation type represents an insertion operation.
+ */
+struct InsertOperation
+{
+    qsizetype index; ///< The position in the old list.
+    qsizetype offset; ///< The position in the new list.
+    qsizetype count; ///< The number of items to be inserted.
+};
+
+/**
+ * The RemoveOperation type represents a remove operation in the old list.
+ */
+struct RemoveOperation
+{
+    qsizetype offset; ///< The position in the old list.
+    qsizetype count; ///< The number of items to be removed.
+};
+
+/**
+ * The MoveOperation type represents a move operation in the old list.
+ */
+struct MoveOperation
+{
+    qsizetype from; ///< The start position in the old list.
+    qsizetype to; /// The target position in the old list.
+    qsizetype count; ///< The number of items to be moved.
+};
+
+using EditOperation = std::variant<InsertOperation, RemoveOperation, MoveOperation>;
+
+/**
+ * This enum type is used to specify additional diff options.
+ */
+enum class DiffOption {
+    /**
+     * Find the matching insert and remove operations and interpret them as moves. Runs of
+     * adjacent items that are moved together are reported as a single move, also if the run
+     * begins or ends with items equal to the ones around it, e.g. empty lines. Note that this
+     * may incur performance penalties.
+     */
+    DetectMoves = 0x1,
+    /**
+     * Map every item to an integer id first, so equal items get equal ids, and compare the
+     * ids instead of the items. Each item is hashed once, which is much cheaper than comparing
+     * items repeatedly if comparing two items is expensive, e.g. if the items are strings.
+     */
+    InternItems = 0x2,
+    /**
+     * Before running the diff algorithm, discard the items that have no equal counterpart in
+     * the other list, as well as very common items that appear in long runs of discarded
+     * items, similar to GNU diff. This speeds up diffs of lists with lots of unique and lots
+     * of repetitive items, e.g. lines of source code, but the resulting sequence of edit
+     * operations may not be the shortest one. This option implies InternItems.
+     */
+    DiscardConfusingItems = 0x4,
+    /**
+     * Bound the time spent on finding the middle snake. If it takes too many steps, the
+     * search is abandoned and the lists are split at the furthest point that has been
+     * reached, similar to the too_expensive heuristic in GNU diff. The resulting sequence of
+     * edit operations is valid, but it may not be the shortest one. The limit can be changed
+     * with DiffWorkspace::setCostLimit().
+     */
+    LimitCost = 0x8,
+    /**
+     * Use the patience diff algorithm. The lists are aligned on the items that occur exactly
+     * once in both of them, and the gaps between those are diffed recursively, falling back
+     * to the Myers' algorithm when there are no unique items left. It's usually faster for
+     * large lists of text lines, and the result is often easier to read, but it may not be the
+     * shortest sequence of edit operations. This option implies InternItems.
+     */
+    PatienceDiff = 0x10,
+    /**
+     * Use the histogram diff algorithm, as found in git. The lists are split recursively at
+     * the longest common run that contains the least frequent items, falling back to the
+     * Myers' algorithm for regions where every common item is too frequent. It handles lists
+     * with lots of repeated items better than the Myers' algorithm, but it may not produce
+     * the shortest sequence of edit operations. It takes precedence over PatienceDiff. This
+     * option implies InternItems.
+     */
+    HistogramDiff = 0x20,
+    /**
+     * Always use the O(NP) algorithm by Wu, Manber, Myers and Miller, where P is the number of
+     * removals if the old list is shorter than the new one, and vice versa. It is chosen
+     * automatically if the sizes of the lists differ substantially, unless LimitCost is
+     * specified. Note that its memory usage grows with the product of the size difference
+     * and P.
+     */
+    WuDiff = 0x40,
+    /**
+     * Always use the bit-parallel LCS algorithm for lists of bitwise comparable items, e.g.
+     * QString or QByteArray, if neither list is longer than 4096 items. It processes 64 items
+     * of the old list per machine word, and it is chosen automatically for such lists if they
+     * are different enough for it to be faster than the Myers' algorithm.
+     */
+    BitParallelDiff = 0x80,
+    /**
+     * Always use the Hunt-Szymanski algorithm, which runs in O((R + N) log N) time, where R is
+     * the number of pairs of equal items in the old and the new list. It is chosen automatically
+     * for interned lists if they have only a few items in common. This option implies
+     * InternItems.
+     */
+    HuntSzymanskiDiff = 0x100,
+    /**
+     * Split large lists into independent parts with the Myers' algorithm, and diff the parts
+     * concurrently on several threads. The number of threads can be changed with
+     * DiffWorkspace::setThreadCount(). Small lists are always diffed on the calling thread.
+     * diffBatch() distributes the pairs over the threads instead. This only affects the Myers'
+     * algorithm; the other algorithms are still chosen automatically if they are faster.
+     */
+    Parallel = 0x200,
+};
+Q_DECLARE_FLAGS(DiffOptions, DiffOption)
+Q_DECLARE_OPERATORS_FOR_FLAGS(DiffOptions)
+
+namespace Private
+{
+
+/**
+ * The HasQHash type trait indicates whether there is a qHash() overload for type @c T.
+ */
+template <typename T, typename = void>
+struct HasQHash : std::false_type
+{
+};
+
+template <typename T>
+struct HasQHash<T, std::void_t<decltype(qHash(std::declval<const T &>(), size_t(0)))>> : std::true_type
+{
+};
+
+/**
+ * The ItemHash struct hashes the item pointed to by the key, using qHash() if available, and
+ * std::hash otherwise.
+ */
+template <typename T>
+struct ItemHash
+{
+    size_t operator()(const T *item) const
+    {
+        if constexpr (HasQHash<T>::value) {
+            return qHash(*item, size_t(0));
+        } else {
+            return std::hash<T>()(*item);
+        }
+    }
+};
+
+template <typename T>
+struct ItemEqual
+{
+    bool operator()(const T *a, const T *b) const
+    {
+        return *a == *b;
+    }
+};
+
+/**
+ * The ItemTable class maps items to dense ids, i.e. the first distinct item gets the id 0, the
+ * second one gets the id 1, and so on. It's an open addressing hash table that refers to the
+ * items by pointers, so the items must not be changed or destroyed while the table is in use.
+ * The slots are kept when the table is reset, so a table that is reused doesn't allocate
+ * once it has grown large enough.
+ */
+class ItemTable
+{
+public:
+    /**
+     * Removes all items from the table, and makes room for up to @a count distinct items.
+     */
+    void reset(qsizetype count)
+    {
+        m_bits = 1;
+        while ((qsizetype(1) << m_bits) < 2 * count) {
+            ++m_bits;
+        }
+        m_slots.assign(size_t(1) << m_bits, Slot());
+        m_size = 0;
+    }
+
+    /**
+     * Returns the number of distinct items in the table.
+     */
+    quint32 size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Returns the id of the specified @a item. If no equal item is in the table yet, the item
+     * is added and gets the next id.
+     */
+    template <typename Item>
+    quint32 insert(const Item *item)
+    {
+        const size_t hash = ItemHash<Item>()(item);
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = size_t((quint64(hash) * 0x9e3779b97f4a7c15) >> (64 - m_bits));; i = (i + 1) & mask) {
+            Slot &slot = m_slots[i];
+            if (!slot.item) {
+                slot = Slot{.hash = hash, .item = item, .id = m_size};
+                return m_size++;
+            }
+            if (slot.hash == hash && ItemEqual<Item>()(static_cast<const Item *>(slot.item), item)) {
+                return slot.id;
+            }
+        }
+    }
+
+    /**
+     * Releases all memory held by the table.
+     */
+    void squeeze()
+    {
+        m_slots = {};
+    }
+
+private:
+    struct Slot
+    {
+        size_t hash = 0;
+        const void *item = nullptr;
+        quint32 id = 0;
+    };
+
+    std::vector<Slot> m_slots;
+    int m_bits = 1;
+    quint32 m_size = 0;
+};
+
+/**
+ * Maps every item in @a oldList and @a newList to an id, so that two items are equal if and
+ * only if their ids are equal. The ids are dense, i.e. they are in range [0, count), where
+ * count is the returned number of distinct items. The @a ids table is used as scratch space.
+ */
+template <typename Container>
+static quint32 intern(const Container &oldList, const Container &newList, ItemTable &ids,
+                      std::vector<quint32> &oldIds, std::vector<quint32> &newIds)
+{
+    using Item = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(oldList))>>;
+
+    ids.reset(qsizetype(oldList.size()) + qsizetype(newList.size()));
+
+    oldIds.clear();
+    newIds.clear();
+    oldIds.reserve(oldList.size());
+    newIds.reserve(newList.size());
+
+    for (const Item &item : oldList) {
+        oldIds.push_back(ids.insert(&item));
+    }
+    for (const Item &item : newList) {
+        newIds.push_back(ids.insert(&item));
+    }
+
+    return ids.size();
+}
+
+/**
+ * The IdList class refers to an interned list stored elsewhere.
+ */
+class IdList
+{
+public:
+    IdList(const std::vector<quint32> &ids)
+        : m_data(ids.data())
+        , m_size(ids.size())
+    {
+    }
+
+    const quint32 *data() const
+    {
+        return m_data;
+    }
+
+    qsizetype size() const
+    {
+        return m_size;
+    }
+
+    const quint32 *begin() const
+    {
+        return m_data;
+    }
+
+    const quint32 *end() const
+    {
+        return m_data + m_size;
+    }
+
+    const quint32 &operator[](qsizetype index) const
+    {
+        return m_data[index];
+    }
+
+private:
+    const quint32 *m_data;
+    qsizetype m_size;
+};
+
+/**
+ * The ItemIds struct refers to the interned old and new lists.
+ */
+struct ItemIds
+{
+    IdList oldIds;
+    IdList newIds;
+    quint32 count; ///< The number of distinct ids.
+};
+
+/**
+ * The PathNode struct represents the end of a snake in the O(NP) algorithm, linked to the end
+ * of the previous snake on the path.
+ */
+template <typename Index>
+struct PathNode
+{
+    Index x;
+    Index y;
+    Index previous;
+};
+
+/**
+ * The MoveSlot struct represents a changed item when detecting moves, i.e. either an item
+ * removed from the old list or an item inserted into the new list.
+ */
+template <typename Index>
+struct MoveSlot
+{
+    Index position; ///< The position of the item in the old or the new list.
+    Index unchanged; ///< The number of unchanged items before the item.
+    Index partner; ///< The slot of the equal item this one is paired with, or -1.
+    Index next; ///< The next slot waiting for a partner with the same item, or -1.
+    bool removed; ///< Whether the item is removed from the old list.
+};
+
+/**
+ * The MoveQueue struct is a list of slots waiting for a partner with the same item, linked
+ * through MoveSlot::next.
+ */
+template <typename Index>
+struct MoveQueue
+{
+    Index first;
+    Index last;
+};
+
+/**
+ * The RunWindow struct is a slot of the hash table that maps the contents of the insertions
+ * to the offsets they can be shifted by when aligning moved runs. Empty slots have the
+ * snake -1.
+ */
+template <typename Index>
+struct RunWindow
+{
+    quint64 hash;
+    Index snake; ///< The index of the insertion in the snake list.
+    Index shift; ///< How far the insertion has to be shifted to contain the window.
+};
+
+/**
+ * The SymbolSlot struct is a slot of the hash table that maps the items to symbols in the
+ * bit-parallel diff. Empty slots have the symbol -1.
+ */
+template <typename Index>
+struct SymbolSlot
+{
+    quint64 key;
+    Index symbol;
+};
+
+/**
+ * The FenwickTree class stores a list of numbers, and computes the sums of its prefixes and
+ * updates individual numbers in O(log n) time.
+ */
+template <typename Index>
+class FenwickTree
+{
+public:
+    /**
+     * Replaces the contents of the tree with the values produced by calling @a value with
+     * every index in range [0, @a size).
+     */
+    template <typename Function>
+    void assign(Index size, Function value)
+    {
+        m_data.resize(size);
+        for (Index i = 0; i < size; ++i) {
+            m_data[i] = value(i);
+        }
+        for (Index i = 1; i <= size; ++i) {
+            const Index parent = i + (i & -i);
+            if (parent <= size) {
+                m_data[parent - 1] += m_data[i - 1];
+            }
+        }
+    }
+
+    /**
+     * Adds @a delta to the value at index @a i.
+     */
+    void add(Index i, Index delta)
+    {
+        for (++i; i <= Index(m_data.size()); i += i & -i) {
+            m_data[i - 1] += delta;
+        }
+    }
+
+    /**
+     * Returns the sum of the values in range [0, @a i).
+     */
+    Index prefix(Index i) const
+    {
+        Index sum = 0;
+        for (; i > 0; i &= i - 1) {
+            sum += m_data[i - 1];
+        }
+        return sum;
+    }
+
+private:
+    std::vector<Index> m_data;
+};
+
+/**
+ * The Buffers struct holds the scratch buffers for one index type.
+ */
+template <typename Index>
+struct Buffers
+{
+    Diagonals<Index> forward;
+    Diagonals<Index> backward;
+    std::vector<Slice<Index>> slices;
+    std::vector<Snake<Index>> snakes;
+
+    // Used by the worker threads of the parallel diff.
+    std::vector<std::unique_ptr<Buffers<Index>>> workers;
+
+    // Used when detecting moves.
+    std::vector<MoveSlot<Index>> moveSlots;
+    FenwickTree<Index> present;
+    ItemTable moveItems;
+    std::vector<MoveQueue<Index>> moveQueues;
+    std::vector<Index> slideUp;
+    std::vector<Index> slideDown;
+    std::vector<RunWindow<Index>> runWindows;
+
+    // Used when discarding items.
+    std::vector<Index> oldCounts;
+    std::vector<Index> newCounts;
+    std::vector<char> oldChanged;
+    std::vector<char> newChanged;
+    std::vector<quint32> oldReduced;
+    std::vector<quint32> newReduced;
+    std::vector<Index> oldMapping;
+    std::vector<Index> newMapping;
+
+    // Used by the patience diff.
+    std::vector<Slice<Index>> regions;
+    std::vector<Index> positions;
+    std::vector<Snake<Index>> anchors;
+    std::vector<Index> piles;
+    std::vector<Index> predecessors;
+
+    // Used by the histogram diff.
+    std::vector<Index> chains;
+
+    // Used by the O(NP) and the Hunt-Szymanski diff.
+    std::vector<PathNode<Index>> nodes;
+
+    // Used by the Hunt-Szymanski diff.
+    std::vector<Index> offsets;
+    std::vector<Index> occurrences;
+
+    // Used by the bit-parallel diff.
+    std::vector<SymbolSlot<Index>> symbols;
+    std::vector<Index> oldSymbols;
+    std::vector<Index> newSymbols;
+    std::vector<quint64> matchMasks;
+    std::vector<quint64> rows;
+};
+
+/**
+ * Calls @a function with a value of the index type suitable for lists with @a oldSize and
+ * @a newSize items, and returns its result. All coordinates and diagonals are bounded by the
+ * sum of both sizes, so qint32 is used if the sum fits in it, which halves the size of the
+ * scratch buffers, and qsizetype otherwise.
+ */
+template <typename Function>
+static auto withIndexType(qsizetype oldSize, qsizetype newSize, Function &&function)
+{
+    if (oldSize + newSize < std::numeric_limits<qint32>::max()) {
+        return function(qint32());
+    } else {
+        return function(qsizetype());
+    }
+}
+
+/**
+ * Returns the slice that remains after stripping the common prefix and suffix of the lists.
+ */
+template <typename Index, typename Container>
+static Slice<Index> trim(const Container &oldList, const Container &newList)
+{
+    const Index oldSize = oldList.size();
+    const Index newSize = newList.size();
+
+    const Index prefix = matchForward(oldList, Index(0), newList, Index(0), std::min(oldSize, newSize));
+    const Index suffix = matchBackward(oldList, oldSize, newList, newSize, std::min(oldSize, newSize) - prefix);
+
+    return Slice<Index>{
+        .x1 = prefix,
+        .x2 = oldSize - suffix,
+        .y1 = prefix,
+        .y2 = newSize - suffix,
+    };
+}
+
+/**
+ * Processes the slices on the slice stack in @a buffers until the next insertion or removal
+ * is found, and stores it in @a snake. Returns @c false if the stack has run empty.
+ *
+ * The right slice is processed first, then the middle snake, and the left slice last, so
+ * the snakes are found in application order, i.e. from the end of the lists to the start.
+ * The search can be suspended after any snake and resumed later, as long as the stack and
+ * the lists are kept intact.
+ */
+template <typename Index, typename Container>
+static bool nextSnake(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                      Index costLimit, Snake<Index> &snake)
+{
+    std::vector<Slice<Index>> &slices = buffers.slices;
+
+    while (!slices.empty()) {
+        const Slice<Index> slice = slices.back();
+        slices.pop_back();
+
+        snake = diffPartial(slice, oldList, newList, buffers.forward, buffers.backward, costLimit);
+
+        snake.x1 += slice.x1;
+        snake.x2 += slice.x1;
+        snake.y1 += slice.y1;
+        snake.y2 += slice.y1;
+
+        const Slice<Index> left {
+            .x1 = slice.x1,
+            .x2 = snake.x1,
+            .y1 = slice.y1,
+            .y2 = snake.y1,
+        };
+
+        const Slice<Index> right {
+            .x1 = snake.x2,
+            .x2 = slice.x2,
+            .y1 = snake.y2,
+            .y2 = slice.y2,
+        };
+
+        if (left.isNull() && right.isNull()) {
+            if (snake.isAddition() || snake.isRemoval()) {
+                return true;
+            }
+            continue;
+        }
+
+        // An insertion or a removal is its own slice, which diffPartial() returns as it is.
+        if (!left.isNull()) {
+            slices.push_back(left);
+        }
+        if (snake.isAddition() || snake.isRemoval()) {
+            slices.push_back(Slice<Index>{.x1 = snake.x1, .x2 = snake.x2, .y1 = snake.y1, .y2 = snake.y2});
+        }
+        if (!right.isNull()) {
+            slices.push_back(right);
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the Myers' algorithm,
+ * and passes them to @a output in application order as soon as they are found.
+ */
+template <typename Index, typename Container, typename Output>
+static void collectSnakes(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                          const Slice<Index> &slice, Index costLimit, Output &&output)
+{
+    std::vector<Slice<Index>> &slices = buffers.slices;
+    slices.clear();
+
+    if (!slice.isNull()) {
+        slices.push_back(slice);
+    }
+
+    Snake<Index> snake;
+    while (nextSnake(buffers, oldList, newList, costLimit, snake)) {
+        output(snake);
+    }
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the Myers' algorithm,
+ * and appends them to the snake list in @a buffers.
+ */
+template <typename Index, typename Container>
+static void collectSnakes(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                          const Slice<Index> &slice, Index costLimit)
+{
+    collectSnakes(buffers, oldList, newList, slice, costLimit, [&buffers](const Snake<Index> &snake) {
+        buffers.snakes.push_back(snake);
+    });
+}
+
+/**
+ * Slices with fewer items than this are not split further between threads.
+ */
+static constexpr qsizetype parallelSliceCutoff = 16384;
+
+/**
+ * The SliceQueue struct is a double-ended queue of slices owned by one worker thread. The
+ * owner takes slices from the back, idle workers steal them from the front.
+ */
+template <typename Index>
+struct SliceQueue
+{
+    std::mutex mutex;
+    std::deque<Slice<Index>> slices;
+};
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the Myers' algorithm on
+ * @a threadCount threads, and appends them to the snake list in @a buffers.
+ *
+ * The left and the right slice of a middle snake share no state, so each worker splits
+ * the slices it takes and pushes both halves onto its own queue, and idle workers steal the
+ * oldest, i.e. the largest, slices from the other queues. Slices below the cutoff are
+ * finished by the worker that took them. Every worker has its own scratch buffers, and the
+ * snakes are merged once all workers are done. While there is only one slice to work on,
+ * e.g. the whole lists at the start, its middle snake search runs on two threads.
+ */
+template <typename Index, typename Container>
+static void collectSnakesParallel(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                                  const Slice<Index> &slice, Index costLimit, int threadCount)
+{
+    while (int(buffers.workers.size()) < threadCount) {
+        buffers.workers.push_back(std::make_unique<Buffers<Index>>());
+    }
+
+    std::vector<SliceQueue<Index>> queues(threadCount);
+    queues[0].slices.push_back(slice);
+
+    // The number of slices that have been queued but not taken yet, and the number of slices
+    // that have been queued but not finished yet.
+    std::atomic<qsizetype> queued(1);
+    std::atomic<qsizetype> pending(1);
+
+    // Workers that find no slice to take sleep until a slice is queued or all are finished.
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    const auto wake = [&](bool all) {
+        {
+            std::lock_guard<std::mutex> locker(idleMutex);
+        }
+        if (all) {
+            idle.notify_all();
+        } else {
+            idle.notify_one();
+        }
+    };
+
+    const auto work = [&](int id) {
+        Buffers<Index> &local = *buffers.workers[id];
+        local.snakes.clear();
+
+        const auto take = [&](Slice<Index> &next) {
+            for (int i = 0; i < threadCount; ++i) {
+                SliceQueue<Index> &queue = queues[(id + i) % threadCount];
+                std::lock_guard<std::mutex> locker(queue.mutex);
+                if (queue.slices.empty()) {
+                    continue;
+                }
+                if (i == 0) {
+                    next = queue.slices.back();
+                    queue.slices.pop_back();
+                } else {
+                    next = queue.slices.front();
+                    queue.slices.pop_front();
+                }
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        };
+
+        const auto finish = [&]() {
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                wake(true);
+            }
+        };
+
+        Slice<Index> current;
+        while (pending.load(std::memory_order_acquire) != 0) {
+            if (!take(current)) {
+                std::unique_lock<std::mutex> locker(idleMutex);
+                idle.wait(locker, [&]() {
+                    return pending.load(std::memory_order_acquire) == 0 || queued.load(std::memory_order_acquire) > 0;
+                });
+                continue;
+            }
+
+            if (qsizetype(current.x2 - current.x1) + (current.y2 - current.y1) < parallelSliceCutoff) {
+                collectSnakes(local, oldList, newList, current, costLimit);
+                finish();
+                continue;
+            }
+
+            // If no other slice is left, the other workers are asleep, so the middle snake
+            // search can run its backward half on a helper thread without competing with them.
+            const bool concurrent = pending.load(std::memory_order_acquire) == 1;
+            Snake<Index> snake = diffPartial(current, oldList, newList, local.forward, local.backward, costLimit, concurrent);
+
+            snake.x1 += current.x1;
+            snake.x2 += current.x1;
+            snake.y1 += current.y1;
+            snake.y2 += current.y1;
+
+            if (snake.isAddition() || snake.isRemoval()) {
+                local.snakes.push_back(snake);
+            }
+
+            const Slice<Index> left {
+                .x1 = current.x1,
+                .x2 = snake.x1,
+                .y1 = current.y1,
+                .y2 = snake.y1,
+            };
+
+            const Slice<Index> right {
+                .x1 = snake.x2,
+                .x2 = current.x2,
+                .y1 = snake.y2,
+                .y2 = current.y2,
+            };
+
+            qsizetype pushed = 0;
+            {
+                SliceQueue<Index> &queue = queues[id];
+                std::lock_guard<std::mutex> locker(queue.mutex);
+                if (!left.isNull()) {
+                    queue.slices.push_back(left);
+                    ++pushed;
+                }
+                if (!right.isNull()) {
+                    queue.slices.push_back(right);
+                    ++pushed;
+                }
+                pending.fetch_add(pushed, std::memory_order_relaxed);
+                queued.fetch_add(pushed, std::memory_order_release);
+            }
+
+            // This worker takes one of the slices itself, so one sleeping worker can steal the
+            // other one.
+            if (pushed > 1) {
+                wake(false);
+            }
+
+            finish();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (int id = 1; id < threadCount; ++id) {
+        threads.emplace_back(work, id);
+    }
+    work(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (int id = 0; id < threadCount; ++id) {
+        const std::vector<Snake<Index>> &snakes = buffers.workers[id]->snakes;
+        buffers.snakes.insert(buffers.snakes.end(), snakes.begin(), snakes.end());
+    }
+}
+
+/**
+ * Passes the edit operation corresponding to the specified @a snake to @a sink, if any.
+ */
+template <typename Index, typename Sink>
+static void emitSnake(const Snake<Index> &snake, Sink &sink)
+{
+    if (snake.isAddition()) {
+        sink(EditOperation(InsertOperation{
+            .index = snake.x1,
+            .offset = snake.y1,
+            .count = snake.y2 - snake.y1,
+        }));
+    } else if (snake.isRemoval()) {
+        sink(EditOperation(RemoveOperation{
+            .offset = snake.x1,
+            .count = snake.x2 - snake.x1,
+        }));
+    }
+}
+
+/**
+ * Sorts the snakes in @a buffers and passes the corresponding edit operations to @a sink.
+ */
+template <typename Index, typename Sink>
+static void emitSnakes(Buffers<Index> &buffers, Sink &sink)
+{
+    std::vector<Snake<Index>> &snakes = buffers.snakes;
+
+    std::sort(snakes.begin(), snakes.end(), [](const auto &a, const auto &b) {
+        return a.x1 == b.x1 ? a.y1 < b.y1 : a.x1 < b.x1;
+    });
+
+    // Traverse the snake path backwards and issue edit commands as we walk the path.
+    for (auto it = snakes.crbegin(); it != snakes.crend(); ++it) {
+        emitSnake(*it, sink);
+    }
+}
+
+/**
+ * Shifts the removals and insertions in the sorted snake list of @a buffers so that a removal
+ * and an insertion with the same items line up, where possible.
+ *
+ * A removal or an insertion can be shifted by one item towards the start if the item before
+ * it is unchanged and equal to its last item, and towards the end if the item after it is
+ * unchanged and equal to its first item. The edit script stays as long, but the removed or
+ * inserted items are rotated. E.g. if a block of rows that contains empty rows is dragged, the
+ * removal may start after an empty row and the insertion right before one, so the items would
+ * be paired off by one and the block would fall apart into many moves.
+ *
+ * The contents of every position that an insertion can be shifted to are hashed, and every
+ * removal is shifted to the first of its positions whose contents match an insertion, which
+ * is shifted accordingly. The shifts are bounded by the unchanged items around every snake,
+ * so this takes linear time.
+ */
+template <typename Index, typename Container>
+static void alignMovedRuns(Buffers<Index> &buffers, const Container &oldList, const Container &newList)
+{
+    using Item = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(oldList))>>;
+
+    std::vector<Snake<Index>> &snakes = buffers.snakes;
+    const Index snakeCount = snakes.size();
+    const Index oldSize = oldList.size();
+
+    const auto itemAt = [](const Container &list, Index position) -> const Item * {
+        return &*std::next(std::begin(list), position);
+    };
+    const auto isRemoval = [&](Index i) {
+        return snakes[i].isRemoval();
+    };
+    const auto listOf = [&](Index i) -> const Container & {
+        return isRemoval(i) ? oldList : newList;
+    };
+    const auto startOf = [&](Index i) {
+        return isRemoval(i) ? snakes[i].x1 : snakes[i].y1;
+    };
+    const auto lengthOf = [&](Index i) {
+        return isRemoval(i) ? snakes[i].x2 - snakes[i].x1 : snakes[i].y2 - snakes[i].y1;
+    };
+
+    // The number of unchanged items before and after every snake. They are the same in both
+    // lists, because the snakes are separated by diagonals.
+    const auto gapBefore = [&](Index i) {
+        return snakes[i].x1 - (i > 0 ? snakes[i - 1].x2 : 0);
+    };
+    const auto gapAfter = [&](Index i) {
+        return (i + 1 < snakeCount ? snakes[i + 1].x1 : oldSize) - snakes[i].x2;
+    };
+
+    std::vector<Index> &slideUp = buffers.slideUp;
+    std::vector<Index> &slideDown = buffers.slideDown;
+    slideUp.resize(snakeCount);
+    slideDown.resize(snakeCount);
+
+    qsizetype windowCount = 0;
+    for (Index i = 0; i < snakeCount; ++i) {
+        const Container &list = listOf(i);
+        const Index first = startOf(i);
+        const Index last = first + lengthOf(i);
+
+        Index up = 0;
+        for (const Index gap = gapBefore(i); up < gap && ItemEqual<Item>()(itemAt(list, first - 1 - up), itemAt(list, last - 1 - up));) {
+            ++up;
+        }
+        Index down = 0;
+        for (const Index gap = gapAfter(i); down < gap && ItemEqual<Item>()(itemAt(list, first + down), itemAt(list, last + down));) {
+            ++down;
+        }
+
+        slideUp[i] = up;
+        slideDown[i] = down;
+        if (!isRemoval(i) && first != last) {
+            windowCount += up + down + 1;
+        }
+    }
+
+    // Calls visit(hash, shift) for every position the snake i can be shifted to, from the
+    // first to the last one, until it returns true. The hash of the items w[0] ... w[n - 1]
+    // is the sum of hash(w[k]) * factor^(n - 1 - k), so shifting by one item towards the
+    // end, which moves w[0] to the back, only takes a multiplication and an addition.
+    constexpr quint64 factor = 0x100000001b3;
+    const auto visitWindows = [&](Index i, auto &&visit) {
+        const Container &list = listOf(i);
+        const Index length = lengthOf(i);
+        const Index first = startOf(i) - slideUp[i];
+
+        quint64 hash = 0;
+        quint64 power = 1;
+        for (Index k = 0; k < length; ++k) {
+            hash = hash * factor + ItemHash<Item>()(itemAt(list, first + k));
+            if (k > 0) {
+                power *= factor;
+            }
+        }
+
+        for (Index shift = -slideUp[i];; ++shift) {
+            if (visit(hash, shift)) {
+                return;
+            }
+            if (shift == slideDown[i]) {
+                return;
+            }
+            const quint64 head = ItemHash<Item>()(itemAt(list, first + shift + slideUp[i]));
+            hash = (hash - head * power) * factor + head;
+        }
+    };
+
+    int bits = 1;
+    while ((qsizetype(1) << bits) < 2 * windowCount) {
+        ++bits;
+    }
+    const size_t mask = (size_t(1) << bits) - 1;
+    std::vector<RunWindow<Index>> &windows = buffers.runWindows;
+    windows.assign(mask + 1, RunWindow<Index>{.hash = 0, .snake = -1, .shift = 0});
+    const auto slotOf = [&](quint64 hash) {
+        return size_t((hash * 0x9e3779b97f4a7c15) >> (64 - bits));
+    };
+
+    for (Index i = 0; i < snakeCount; ++i) {
+        if (isRemoval(i) || lengthOf(i) == 0) {
+            continue;
+        }
+        visitWindows(i, [&](quint64 hash, Index shift) {
+            size_t slot = slotOf(hash);
+            while (windows[slot].snake != -1 && windows[slot].hash != hash) {
+                slot = (slot + 1) & mask;
+            }
+            if (windows[slot].snake == -1) {
+                windows[slot] = RunWindow<Index>{.hash = hash, .snake = i, .shift = shift};
+            }
+            return false;
+        });
+    }
+
+    // The neighbors may have been shifted meanwhile, so the gaps are checked again.
+    const auto canShift = [&](Index i, Index shift) {
+        return shift < 0 ? -shift <= gapBefore(i) : shift <= gapAfter(i);
+    };
+    const auto shiftSnake = [&](Index i, Index shift) {
+        snakes[i].x1 += shift;
+        snakes[i].x2 += shift;
+        snakes[i].y1 += shift;
+        snakes[i].y2 += shift;
+    };
+
+    for (Index i = 0; i < snakeCount; ++i) {
+        if (!isRemoval(i) || lengthOf(i) == 0) {
+            continue;
+        }
+        visitWindows(i, [&](quint64 hash, Index shift) {
+            size_t slot = slotOf(hash);
+            while (windows[slot].snake != -1 && windows[slot].hash != hash) {
+                slot = (slot + 1) & mask;
+            }
+            RunWindow<Index> &window = windows[slot];
+            if (window.snake == -1 || lengthOf(window.snake) != lengthOf(i)) {
+                return false;
+            }
+
+            // Make sure that the items are equal, not just their hashes.
+            const Index removed = startOf(i) + shift;
+            const Index inserted = startOf(window.snake) + window.shift;
+            for (Index k = 0; k < lengthOf(i); ++k) {
+                if (!ItemEqual<Item>()(itemAt(oldList, removed + k), itemAt(newList, inserted + k))) {
+                    return false;
+                }
+            }
+
+            // Every insertion is lined up with one removal at most. If the removal is right next
+            // to the insertion, shifting one of them changes the room left for the other.
+            const Index partner = window.snake;
+            if (!canShift(partner, window.shift) || !canShift(i, shift)) {
+                return false;
+            }
+            shiftSnake(partner, window.shift);
+            if (!canShift(i, shift)) {
+                shiftSnake(partner, -window.shift);
+                return false;
+            }
+            shiftSnake(i, shift);
+            window.snake = -1;
+            return true;
+        });
+    }
+}
+
+/**
+ * Converts the snakes in @a buffers to edit operations, turns the removals and insertions of
+ * equal items into moves, and passes the operations to @a sink in application order.
+ *
+ * Every removed and every inserted item gets a slot, and the slots are ordered as the items
+ * appear along the edit path. At any point while the operations are applied, the current
+ * list consists of the unchanged items and the slots that are present, in that order, so the
+ * position of an item is the number of unchanged items before it plus the number of present
+ * slots before it, which is tracked in a Fenwick tree. The removals and insertions are paired
+ * up in application order using queues of slots waiting for a partner with the same item,
+ * and each pair is turned into a move when its first operation is reached. Before that, the
+ * removals and insertions are shifted with alignMovedRuns(), so that a run of moved items
+ * is paired as a whole.
+ *
+ * This takes O(n log n) time, where n is the number of changed items.
+ */
+template <typename Index, typename Container, typename Sink>
+static void detectMoves(Buffers<Index> &buffers, const Container &oldList, const Container &newList, Sink &sink)
+{
+    using Item = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(oldList))>>;
+
+    std::vector<Snake<Index>> &snakes = buffers.snakes;
+    std::sort(snakes.begin(), snakes.end(), [](const auto &a, const auto &b) {
+        return a.x1 == b.x1 ? a.y1 < b.y1 : a.x1 < b.x1;
+    });
+    alignMovedRuns(buffers, oldList, newList);
+
+    std::vector<MoveSlot<Index>> &slots = buffers.moveSlots;
+    slots.clear();
+
+    Index removedCount = 0;
+    Index insertedCount = 0;
+    for (const Snake<Index> &snake : snakes) {
+        for (Index x = snake.x1; x < snake.x2; ++x) {
+            slots.push_back(MoveSlot<Index>{.position = x, .unchanged = x - removedCount, .partner = -1, .next = -1, .removed = true});
+            ++removedCount;
+        }
+        for (Index y = snake.y1; y < snake.y2; ++y) {
+            slots.push_back(MoveSlot<Index>{.position = y, .unchanged = y - insertedCount, .partner = -1, .next = -1, .removed = false});
+            ++insertedCount;
+        }
+    }
+
+    const Index slotCount = slots.size();
+    const auto itemAt = [&](const MoveSlot<Index> &slot) -> const Item * {
+        return slot.removed ? &*std::next(std::begin(oldList), slot.position) : &*std::next(std::begin(newList), slot.position);
+    };
+
+    // Pair every slot with a slot of the opposite kind and with an equal item that precedes it
+    // in application order and hasn't been paired yet. If the previous slot has been paired,
+    // the slot next to its partner is preferred, so that runs of items moved together stay
+    // together. Otherwise, the slot that has been waiting the longest is taken.
+    // The slots waiting for a partner are queued per item, and the items are numbered by a
+    // hash table to find their queues.
+    ItemTable &items = buffers.moveItems;
+    items.reset(slotCount);
+    std::vector<MoveQueue<Index>> &queues = buffers.moveQueues;
+    queues.clear();
+
+    for (Index i = slotCount - 1; i >= 0; --i) {
+        const Item *item = itemAt(slots[i]);
+        const quint32 id = items.insert(item);
+        if (id == queues.size()) {
+            queues.push_back(MoveQueue<Index>{.first = -1, .last = -1});
+        }
+        MoveQueue<Index> &queue = queues[id];
+
+        // Slots paired out of order are dropped from the queue lazily.
+        while (queue.first != -1 && slots[queue.first].partner != -1) {
+            queue.first = slots[queue.first].next;
+        }
+        if (queue.first == -1) {
+            queue.last = -1;
+        }
+
+        if (queue.first != -1 && slots[queue.first].removed != slots[i].removed) {
+            Index partner = queue.first;
+            if (i + 1 < slotCount && slots[i + 1].removed == slots[i].removed && slots[i + 1].partner != -1) {
+                const Index neighbor = slots[i + 1].partner - 1;
+                if (neighbor > i && slots[neighbor].partner == -1 && slots[neighbor].removed != slots[i].removed
+                    && ItemEqual<Item>()(itemAt(slots[neighbor]), item)) {
+                    partner = neighbor;
+                }
+            }
+            if (partner == queue.first) {
+                queue.first = slots[partner].next;
+                if (queue.first == -1) {
+                    queue.last = -1;
+                }
+            }
+            slots[partner].partner = i;
+            slots[i].partner = partner;
+        } else {
+            if (queue.last != -1) {
+                slots[queue.last].next = i;
+            } else {
+                queue.first = i;
+            }
+            queue.last = i;
+        }
+    }
+
+    FenwickTree<Index> &present = buffers.present;
+    present.assign(slotCount, [&slots](Index i) {
+        return Index(slots[i].removed ? 1 : 0);
+    });
+
+    const auto positionOf = [&](Index i) {
+        return slots[i].unchanged + present.prefix(i);
+    };
+
+    // Adjacent removals and insertions that are not paired are merged back, and so are moves
+    // of adjacent items that end up next to each other.
+    EditOperation pending;
+    bool hasPending = false;
+    const auto emit = [&](const EditOperation &operation) {
+        if (hasPending) {
+            if (auto move = std::get_if<MoveOperation>(&pending)) {
+                if (auto next = std::get_if<MoveOperation>(&operation)) {
+                    // The next item precedes the block. If the block has been moved forward,
+                    // the item is still in front of it, otherwise it has been shifted by the
+                    // block. In both cases, it must be moved right in front of the block.
+                    const bool forward = move->to >= move->from;
+                    const qsizetype from = forward ? move->from - 1 : move->from - 1 + move->count;
+                    const qsizetype to = forward ? move->to - 1 : move->to;
+                    if (next->from == from && next->to == to) {
+                        --move->from;
+                        move->to = to;
+                        ++move->count;
+                        return;
+                    }
+                }
+            } else if (auto remove = std::get_if<RemoveOperation>(&pending)) {
+                if (auto next = std::get_if<RemoveOperation>(&operation); next && next->offset == remove->offset - 1) {
+                    --remove->offset;
+                    ++remove->count;
+                    return;
+                }
+            } else if (auto insert = std::get_if<InsertOperation>(&pending)) {
+                if (auto next = std::get_if<InsertOperation>(&operation); next && next->index == insert->index && next->offset == insert->offset - 1) {
+                    --insert->offset;
+                    ++insert->count;
+                    return;
+                }
+            }
+            sink(pending);
+        }
+        pending = operation;
+        hasPending = true;
+    };
+
+    for (Index i = slotCount - 1; i >= 0; --i) {
+        const MoveSlot<Index> &slot = slots[i];
+        if (slot.partner > i) {
+            continue; // Already moved.
+        }
+
+        if (slot.partner == -1) {
+            if (slot.removed) {
+                emit(RemoveOperation{
+                    .offset = positionOf(i),
+                    .count = 1,
+                });
+                present.add(i, -1);
+            } else {
+                emit(InsertOperation{
+                    .index = positionOf(i),
+                    .offset = slot.position,
+                    .count = 1,
+                });
+                present.add(i, 1);
+            }
+            continue;
+        }
+
+        const Index source = slot.removed ? i : slot.partner;
+        const Index target = slot.removed ? slot.partner : i;
+
+        const Index from = positionOf(source);
+        present.add(source, -1);
+        const Index to = positionOf(target);
+        present.add(target, 1);
+
+        if (from != to) {
+            emit(MoveOperation{
+                .from = from,
+                .to = to,
+                .count = 1,
+            });
+        }
+    }
+
+    if (hasPending) {
+        sink(pending);
+    }
+}
+
+/**
+ * Marks the items in range [@a first, @a last) of the @a ids list that can be discarded. An
+ * item is discarded (1) if it has no counterpart in the other list, whose id histogram is
+ * given by @a otherCounts, and provisionally discarded (2) if it's very common there.
+ *
+ * Provisionally discarded items are kept unless they are surrounded by enough discarded
+ * items, so that they only get discarded if they would make the diff algorithm go astray.
+ * This follows the discard_confusing_lines() heuristic in GNU diff.
+ */
+template <typename Index>
+static void markDiscards(const IdList &ids, Index first, Index last,
+                         const std::vector<Index> &otherCounts, std::vector<char> &discards)
+{
+    const Index length = last - first;
+    discards.assign(length, 0);
+
+    Index many = 5;
+    for (Index tem = length / 64; (tem >>= 2) > 0;) {
+        many *= 2;
+    }
+
+    for (Index i = 0; i < length; ++i) {
+        const Index matches = otherCounts[ids[first + i]];
+        if (matches == 0) {
+            discards[i] = 1;
+        } else if (matches > many) {
+            discards[i] = 2;
+        }
+    }
+
+    for (Index i = 0; i < length; ++i) {
+        if (discards[i] == 2) {
+            // A provisional discard that doesn't follow a definite one is kept.
+            discards[i] = 0;
+        } else if (discards[i] != 0) {
+            // Find the end of this run of discardable items and count the provisional ones.
+            Index j = i;
+            Index provisional = 0;
+            for (; j < length && discards[j] != 0; ++j) {
+                if (discards[j] == 2) {
+                    ++provisional;
+                }
+            }
+
+            // Keep the provisional discards at the end of the run.
+            while (j > i && discards[j - 1] == 2) {
+                discards[--j] = 0;
+                --provisional;
+            }
+
+            const Index runLength = j - i;
+
+            if (provisional * 4 > runLength) {
+                // Too many provisional discards, keep all of them.
+                while (j > i) {
+                    if (discards[--j] == 2) {
+                        discards[j] = 0;
+                    }
+                }
+            } else {
+                // Keep every subrun of provisional discards that is longer than roughly the
+                // square root of a quarter of the run.
+                Index minimum = 1;
+                for (Index tem = runLength >> 2; (tem >>= 2) > 0;) {
+                    minimum <<= 1;
+                }
+                ++minimum;
+
+                for (Index k = 0, consecutive = 0; k < runLength; ++k) {
+                    if (discards[i + k] != 2) {
+                        consecutive = 0;
+                    } else if (minimum == ++consecutive) {
+                        k -= consecutive;
+                    } else if (minimum < consecutive) {
+                        discards[i + k] = 0;
+                    }
+                }
+
+                // Keep the provisional discards near either end of the run, until there are
+                // three definite discards in a row or eight items have been seen.
+                for (Index k = 0, consecutive = 0; k < runLength; ++k) {
+                    if (k >= 8 && discards[i + k] == 1) {
+                        break;
+                    }
+                    if (discards[i + k] == 2) {
+                        consecutive = 0;
+                        discards[i + k] = 0;
+                    } else if (discards[i + k] == 0) {
+                        consecutive = 0;
+                    } else if (++consecutive == 3) {
+                        break;
+                    }
+                }
+
+                i += runLength - 1;
+
+                for (Index k = 0, consecutive = 0; k < runLength; ++k) {
+                    if (k >= 8 && discards[i - k] == 1) {
+                        break;
+                    }
+                    if (discards[i - k] == 2) {
+                        consecutive = 0;
+                        discards[i - k] = 0;
+                    } else if (discards[i - k] == 0) {
+                        consecutive = 0;
+                    } else if (++consecutive == 3) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Rebuilds the snake list in @a buffers from the change flags, where the flags describe the
+ * items in the specified @a slice.
+ */
+template <typename Index>
+static void collectSnakesFromChanges(Buffers<Index> &buffers, const Slice<Index> &slice)
+{
+    const std::vector<char> &oldChanged = buffers.oldChanged;
+    const std::vector<char> &newChanged = buffers.newChanged;
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+
+    Index x = 0;
+    Index y = 0;
+    while (x < oldSize || y < newSize) {
+        if (x < oldSize && y < newSize && !oldChanged[x] && !newChanged[y]) {
+            ++x;
+            ++y;
+            continue;
+        }
+
+        const Index x1 = x;
+        const Index y1 = y;
+        while (x < oldSize && oldChanged[x]) {
+            ++x;
+        }
+        while (y < newSize && newChanged[y]) {
+            ++y;
+        }
+
+        if (x != x1) {
+            buffers.snakes.push_back(Snake<Index>{
+                .x1 = slice.x1 + x1,
+                .x2 = slice.x1 + x,
+                .y1 = slice.y1 + y1,
+                .y2 = slice.y1 + y1,
+            });
+        }
+        if (y != y1) {
+            buffers.snakes.push_back(Snake<Index>{
+                .x1 = slice.x1 + x,
+                .x2 = slice.x1 + x,
+                .y1 = slice.y1 + y1,
+                .y2 = slice.y1 + y,
+            });
+        }
+    }
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice after discarding the items that
+ * have no counterpart in the other list, or that are too common, see markDiscards().
+ */
+template <typename Index>
+static void collectSnakesDiscarding(Buffers<Index> &buffers, const ItemIds &ids, const Slice<Index> &slice, Index costLimit)
+{
+    buffers.oldCounts.assign(ids.count, 0);
+    buffers.newCounts.assign(ids.count, 0);
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        ++buffers.oldCounts[ids.oldIds[x]];
+    }
+    for (Index y = slice.y1; y < slice.y2; ++y) {
+        ++buffers.newCounts[ids.newIds[y]];
+    }
+
+    markDiscards(ids.oldIds, slice.x1, slice.x2, buffers.newCounts, buffers.oldChanged);
+    markDiscards(ids.newIds, slice.y1, slice.y2, buffers.oldCounts, buffers.newChanged);
+
+    const auto reduce = [](const IdList &ids, Index first, std::vector<char> &changed,
+                           std::vector<quint32> &reduced, std::vector<Index> &mapping) {
+        reduced.clear();
+        mapping.clear();
+        for (Index i = 0; i < Index(changed.size()); ++i) {
+            if (changed[i]) {
+                changed[i] = 1;
+            } else {
+                reduced.push_back(ids[first + i]);
+                mapping.push_back(i);
+            }
+        }
+    };
+    reduce(ids.oldIds, slice.x1, buffers.oldChanged, buffers.oldReduced, buffers.oldMapping);
+    reduce(ids.newIds, slice.y1, buffers.newChanged, buffers.newReduced, buffers.newMapping);
+
+    // Diff the reduced lists, and mark the items that have been changed there, too.
+    buffers.snakes.clear();
+    collectSnakes(buffers, buffers.oldReduced, buffers.newReduced, trim<Index>(buffers.oldReduced, buffers.newReduced), costLimit);
+
+    for (const Snake<Index> &snake : buffers.snakes) {
+        for (Index x = snake.x1; x < snake.x2; ++x) {
+            buffers.oldChanged[buffers.oldMapping[x]] = 1;
+        }
+        for (Index y = snake.y1; y < snake.y2; ++y) {
+            buffers.newChanged[buffers.newMapping[y]] = 1;
+        }
+    }
+
+    buffers.snakes.clear();
+    collectSnakesFromChanges(buffers, slice);
+}
+
+/**
+ * Finds the longest sequence of unique items common to both lists in the specified @a slice
+ * and stores it in the anchor list in @a buffers. An anchor is represented as an empty snake
+ * at the position of the item in both lists.
+ */
+template <typename Index>
+static void findPatienceAnchors(Buffers<Index> &buffers, const ItemIds &ids, const Slice<Index> &slice)
+{
+    std::vector<Index> &oldCounts = buffers.oldCounts;
+    std::vector<Index> &newCounts = buffers.newCounts;
+    std::vector<Snake<Index>> &anchors = buffers.anchors;
+    anchors.clear();
+
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        ++oldCounts[ids.oldIds[x]];
+    }
+    for (Index y = slice.y1; y < slice.y2; ++y) {
+        const quint32 id = ids.newIds[y];
+        ++newCounts[id];
+        buffers.positions[id] = y;
+    }
+
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        const quint32 id = ids.oldIds[x];
+        if (oldCounts[id] == 1 && newCounts[id] == 1) {
+            const Index y = buffers.positions[id];
+            anchors.push_back(Snake<Index>{.x1 = x, .x2 = x, .y1 = y, .y2 = y});
+        }
+    }
+
+    // The counters are shared by all regions, so reset them.
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        oldCounts[ids.oldIds[x]] = 0;
+    }
+    for (Index y = slice.y1; y < slice.y2; ++y) {
+        newCounts[ids.newIds[y]] = 0;
+    }
+
+    if (anchors.empty()) {
+        return;
+    }
+
+    // The anchors are sorted by their positions in the old list. Find the longest increasing
+    // subsequence of their positions in the new list with patience sorting. Every pile is
+    // represented by the anchor on top of it.
+    std::vector<Index> &piles = buffers.piles;
+    std::vector<Index> &predecessors = buffers.predecessors;
+    piles.clear();
+    predecessors.resize(anchors.size());
+
+    for (Index i = 0; i < Index(anchors.size()); ++i) {
+        const auto pile = std::lower_bound(piles.begin(), piles.end(), anchors[i].y1, [&anchors](Index top, Index y) {
+            return anchors[top].y1 < y;
+        });
+        predecessors[i] = pile == piles.begin() ? -1 : *std::prev(pile);
+        if (pile == piles.end()) {
+            piles.push_back(i);
+        } else {
+            *pile = i;
+        }
+    }
+
+    // Walk the sequence backwards, and compact the anchors. The piles aren't needed anymore.
+    Index count = piles.size();
+    for (Index i = piles.back(), j = count - 1; i != -1; i = predecessors[i], --j) {
+        piles[j] = i;
+    }
+    for (Index j = 0; j < count; ++j) {
+        anchors[j] = anchors[piles[j]];
+    }
+    anchors.resize(count);
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the patience diff
+ * algorithm. The regions without unique common items are diffed with the Myers' algorithm.
+ */
+template <typename Index>
+static void collectSnakesPatience(Buffers<Index> &buffers, const ItemIds &ids, const Slice<Index> &slice, Index costLimit)
+{
+    buffers.oldCounts.assign(ids.count, 0);
+    buffers.newCounts.assign(ids.count, 0);
+    buffers.positions.resize(ids.count);
+
+    std::vector<Slice<Index>> &regions = buffers.regions;
+    regions.clear();
+    regions.push_back(slice);
+
+    while (!regions.empty()) {
+        Slice<Index> region = regions.back();
+        regions.pop_back();
+
+        const Index prefix = matchForward(ids.oldIds, region.x1, ids.newIds, region.y1,
+                                          std::min(region.x2 - region.x1, region.y2 - region.y1));
+        region.x1 += prefix;
+        region.y1 += prefix;
+
+        const Index suffix = matchBackward(ids.oldIds, region.x2, ids.newIds, region.y2,
+                                           std::min(region.x2 - region.x1, region.y2 - region.y1));
+        region.x2 -= suffix;
+        region.y2 -= suffix;
+
+        if (region.isNull()) {
+            continue;
+        }
+
+        findPatienceAnchors(buffers, ids, region);
+        if (buffers.anchors.empty()) {
+            collectSnakes(buffers, ids.oldIds, ids.newIds, region, costLimit);
+            continue;
+        }
+
+        Index x = region.x1;
+        Index y = region.y1;
+        for (const Snake<Index> &anchor : buffers.anchors) {
+            regions.push_back(Slice<Index>{.x1 = x, .x2 = anchor.x1, .y1 = y, .y2 = anchor.y1});
+            x = anchor.x1 + 1;
+            y = anchor.y1 + 1;
+        }
+        regions.push_back(Slice<Index>{.x1 = x, .x2 = region.x2, .y1 = y, .y2 = region.y2});
+    }
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the histogram diff
+ * algorithm. Every region is split at the longest common run of items whose least frequent
+ * item occurs the least often in the old list. If every common item in a region occurs more
+ * than 64 times, the region is diffed with the Myers' algorithm instead.
+ */
+template <typename Index>
+static void collectSnakesHistogram(Buffers<Index> &buffers, const ItemIds &ids, const Slice<Index> &slice, Index costLimit)
+{
+    constexpr Index maxChainLength = 64;
+
+    const IdList &oldIds = ids.oldIds;
+    const IdList &newIds = ids.newIds;
+    std::vector<Index> &counts = buffers.oldCounts;
+    std::vector<Index> &heads = buffers.positions;
+    std::vector<Index> &chains = buffers.chains;
+    counts.assign(ids.count, 0);
+    heads.resize(ids.count);
+
+    std::vector<Slice<Index>> &regions = buffers.regions;
+    regions.clear();
+    regions.push_back(slice);
+
+    while (!regions.empty()) {
+        Slice<Index> region = regions.back();
+        regions.pop_back();
+
+        const Index prefix = matchForward(oldIds, region.x1, newIds, region.y1,
+                                          std::min(region.x2 - region.x1, region.y2 - region.y1));
+        region.x1 += prefix;
+        region.y1 += prefix;
+
+        const Index suffix = matchBackward(oldIds, region.x2, newIds, region.y2,
+                                           std::min(region.x2 - region.x1, region.y2 - region.y1));
+        region.x2 -= suffix;
+        region.y2 -= suffix;
+
+        if (region.isNull()) {
+            continue;
+        }
+
+        // Build the histogram of the old list. Every item is chained to the next occurrence.
+        chains.resize(region.x2 - region.x1);
+        for (Index x = region.x2 - 1; x >= region.x1; --x) {
+            const quint32 id = oldIds[x];
+            chains[x - region.x1] = counts[id] ? heads[id] : -1;
+            heads[id] = x;
+            ++counts[id];
+        }
+
+        bool hasCommon = false;
+        Index bestCount = maxChainLength + 1;
+        Slice<Index> best{.x1 = 0, .x2 = 0, .y1 = 0, .y2 = 0};
+
+        for (Index y = region.y1; y < region.y2;) {
+            Index nextY = y + 1;
+            const quint32 id = newIds[y];
+            if (counts[id] == 0) {
+                y = nextY;
+                continue;
+            }
+
+            hasCommon = true;
+            if (counts[id] > bestCount) {
+                y = nextY;
+                continue;
+            }
+
+            for (Index x = heads[id]; x != -1;) {
+                // Extend the match in both directions, and find the least frequent item in it.
+                Index runCount = counts[id];
+                Index x1 = x;
+                Index y1 = y;
+                while (x1 > region.x1 && y1 > region.y1 && oldIds[x1 - 1] == newIds[y1 - 1]) {
+                    --x1;
+                    --y1;
+                    runCount = std::min(runCount, counts[oldIds[x1]]);
+                }
+
+                Index x2 = x + 1;
+                Index y2 = y + 1;
+                while (x2 < region.x2 && y2 < region.y2 && oldIds[x2] == newIds[y2]) {
+                    runCount = std::min(runCount, counts[oldIds[x2]]);
+                    ++x2;
+                    ++y2;
+                }
+
+                nextY = std::max(nextY, y2);
+
+                if (best.x2 - best.x1 < x2 - x1 || runCount < bestCount) {
+                    best = Slice<Index>{.x1 = x1, .x2 = x2, .y1 = y1, .y2 = y2};
+                    bestCount = runCount;
+                }
+
+                // Skip the occurrences that are covered by this run.
+                do {
+                    x = chains[x - region.x1];
+                } while (x != -1 && x < x2);
+            }
+
+            y = nextY;
+        }
+
+        for (Index x = region.x1; x < region.x2; ++x) {
+            counts[oldIds[x]] = 0;
+        }
+
+        if (!hasCommon) {
+            if (region.x1 != region.x2) {
+                buffers.snakes.push_back(Snake<Index>{.x1 = region.x1, .x2 = region.x2, .y1 = region.y1, .y2 = region.y1});
+            }
+            if (region.y1 != region.y2) {
+                buffers.snakes.push_back(Snake<Index>{.x1 = region.x2, .x2 = region.x2, .y1 = region.y1, .y2 = region.y2});
+            }
+        } else if (bestCount > maxChainLength) {
+            collectSnakes(buffers, oldIds, newIds, region, costLimit);
+        } else {
+            regions.push_back(Slice<Index>{.x1 = region.x1, .x2 = best.x1, .y1 = region.y1, .y2 = best.y1});
+            regions.push_back(Slice<Index>{.x1 = best.x2, .x2 = region.x2, .y1 = best.y2, .y2 = region.y2});
+        }
+    }
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the O(NP) algorithm
+ * described in "An O(NP) Sequence Comparison Algorithm" by Wu, Manber, Myers and Miller.
+ *
+ * The algorithm keeps one path node per extended snake. If more than @a maxNodes nodes are
+ * needed, the search is abandoned and @c false is returned.
+ */
+template <typename Index, typename Container>
+static bool collectSnakesWu(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                            const Slice<Index> &slice, qsizetype maxNodes)
+{
+    // The algorithm requires the first list to be the shorter one, so swap them if needed.
+    const bool swapped = slice.x2 - slice.x1 > slice.y2 - slice.y1;
+    const Index shortSize = swapped ? slice.y2 - slice.y1 : slice.x2 - slice.x1;
+    const Index longSize = swapped ? slice.x2 - slice.x1 : slice.y2 - slice.y1;
+    const Index delta = longSize - shortSize;
+
+    // Here, x is a position in the shorter list, and y is a position in the longer list.
+    const auto snake = [&](Index x, Index y) {
+        const Index count = std::min(shortSize - x, longSize - y);
+        if (swapped) {
+            return matchForward(newList, slice.y1 + x, oldList, slice.x1 + y, count);
+        } else {
+            return matchForward(oldList, slice.x1 + x, newList, slice.y1 + y, count);
+        }
+    };
+
+    // The diagonal k is defined as y - x. The furthest reaching y on every diagonal is stored
+    // in the forward vector, and the corresponding path node in the backward vector.
+    Diagonals<Index> &furthest = buffers.forward;
+    Diagonals<Index> &paths = buffers.backward;
+    std::vector<PathNode<Index>> &nodes = buffers.nodes;
+    nodes.clear();
+
+    furthest.reserve(delta + 1);
+    paths.reserve(delta + 1);
+    for (Index k = -1; k <= delta + 1; ++k) {
+        furthest[k] = -1;
+        paths[k] = -1;
+    }
+
+    const auto extend = [&](Index k) {
+        Index y;
+        Index previous;
+        if (furthest[k - 1] + 1 > furthest[k + 1]) {
+            y = furthest[k - 1] + 1;
+            previous = paths[k - 1];
+        } else {
+            y = furthest[k + 1];
+            previous = paths[k + 1];
+        }
+
+        const Index matched = snake(y - k, y);
+        furthest[k] = y + matched;
+        paths[k] = nodes.size();
+        nodes.push_back(PathNode<Index>{.x = y + matched - k, .y = y + matched, .previous = previous});
+    };
+
+    for (Index p = 0; furthest[delta] != longSize; ++p) {
+        if (qsizetype(nodes.size()) > maxNodes) {
+            return false;
+        }
+
+        furthest.reserve(delta + p + 1);
+        paths.reserve(delta + p + 1);
+        furthest[-p - 1] = -1;
+        furthest[delta + p + 1] = -1;
+        paths[-p - 1] = -1;
+        paths[delta + p + 1] = -1;
+
+        for (Index k = -p; k < delta; ++k) {
+            extend(k);
+        }
+        for (Index k = delta + p; k > delta; --k) {
+            extend(k);
+        }
+        extend(delta);
+    }
+
+    // Walk the path backwards and mark the items that have been removed or inserted. Every
+    // node is reached from the previous one by one edit followed by a snake.
+    std::vector<char> &shortChanged = swapped ? buffers.newChanged : buffers.oldChanged;
+    std::vector<char> &longChanged = swapped ? buffers.oldChanged : buffers.newChanged;
+    shortChanged.assign(shortSize, 0);
+    longChanged.assign(longSize, 0);
+
+    for (Index i = paths[delta]; i != -1; i = nodes[i].previous) {
+        const PathNode<Index> &node = nodes[i];
+        if (node.previous == -1) {
+            break;
+        }
+
+        const PathNode<Index> &previous = nodes[node.previous];
+        if (node.y - node.x > previous.y - previous.x) {
+            longChanged[previous.y] = 1;
+        } else {
+            shortChanged[previous.x] = 1;
+        }
+    }
+
+    collectSnakesFromChanges(buffers, slice);
+    return true;
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the Hunt-Szymanski
+ * algorithm. For every old item, the occurrences of equal items in the new list are visited
+ * backwards, and the matches are recorded in a list of thresholds, where the k-th threshold
+ * is the smallest position in the new list at which a common subsequence of length k + 1 ends.
+ *
+ * Unless @a force is @c true, @c false is returned without doing anything if the number of
+ * pairs of equal items is too large for the algorithm to be faster than the Myers' algorithm.
+ */
+template <typename Index>
+static bool collectSnakesHuntSzymanski(Buffers<Index> &buffers, const ItemIds &ids, const Slice<Index> &slice, bool force)
+{
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+    if (oldSize < 1 || newSize < 1) {
+        return false;
+    }
+
+    std::vector<Index> &oldCounts = buffers.oldCounts;
+    std::vector<Index> &offsets = buffers.offsets;
+    oldCounts.assign(ids.count, 0);
+    offsets.assign(ids.count + 1, 0);
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        ++oldCounts[ids.oldIds[x]];
+    }
+    for (Index y = slice.y1; y < slice.y2; ++y) {
+        ++offsets[ids.newIds[y] + 1];
+    }
+
+    qsizetype matches = 0;
+    for (quint32 id = 0; id < ids.count; ++id) {
+        matches += qsizetype(oldCounts[id]) * offsets[id + 1];
+    }
+
+    if (!force) {
+        // The LCS can't be longer than the number of matching pairs, which gives a lower bound
+        // of the edit distance, and thus of the time the Myers' algorithm takes.
+        const qsizetype size = qsizetype(oldSize) + newSize;
+        const qsizetype distance = size - 2 * std::min<qsizetype>(matches, std::min(oldSize, newSize));
+        qsizetype log = 1;
+        while ((qsizetype(1) << log) < size) {
+            ++log;
+        }
+        if (4 * (matches + size) * log >= size * distance) {
+            return false;
+        }
+    }
+
+    // Bucket the positions of the new items by id, in ascending order.
+    for (quint32 id = 0; id < ids.count; ++id) {
+        offsets[id + 1] += offsets[id];
+    }
+    std::vector<Index> &occurrences = buffers.occurrences;
+    occurrences.resize(newSize);
+    for (Index y = slice.y1; y < slice.y2; ++y) {
+        occurrences[offsets[ids.newIds[y]]++] = y;
+    }
+    // Every offset points at the end of its bucket now, i.e. at the start of the next one.
+
+    std::vector<Index> &thresholds = buffers.piles;
+    std::vector<Index> &links = buffers.predecessors;
+    std::vector<PathNode<Index>> &nodes = buffers.nodes;
+    thresholds.clear();
+    links.clear();
+    nodes.clear();
+
+    for (Index x = slice.x1; x < slice.x2; ++x) {
+        const quint32 id = ids.oldIds[x];
+        const Index first = id == 0 ? 0 : offsets[id - 1];
+        for (Index i = offsets[id] - 1; i >= first; --i) {
+            const Index y = occurrences[i];
+            const auto threshold = std::lower_bound(thresholds.begin(), thresholds.end(), y);
+            const Index k = threshold - thresholds.begin();
+            if (threshold == thresholds.end()) {
+                thresholds.push_back(y);
+                links.push_back(nodes.size());
+            } else if (*threshold == y) {
+                continue;
+            } else {
+                *threshold = y;
+                links[k] = nodes.size();
+            }
+            nodes.push_back(PathNode<Index>{.x = x, .y = y, .previous = k == 0 ? -1 : links[k - 1]});
+        }
+    }
+
+    buffers.oldChanged.assign(oldSize, 1);
+    buffers.newChanged.assign(newSize, 1);
+    for (Index i = links.empty() ? -1 : links.back(); i != -1; i = nodes[i].previous) {
+        buffers.oldChanged[nodes[i].x - slice.x1] = 0;
+        buffers.newChanged[nodes[i].y - slice.y1] = 0;
+    }
+
+    collectSnakesFromChanges(buffers, slice);
+    return true;
+}
+
+/**
+ * Returns the number of insertions and removals needed to turn the old part of the specified
+ * @a slice into its new part, or @a maxDistance + 1 if more than @a maxDistance edits are
+ * needed. The slice must have no common prefix and suffix.
+ *
+ * This runs the rounds of the middle snake search of diffPartial(), but doesn't recurse. By
+ * the time the forward and the backward paths overlap, the length of the shortest edit
+ * script is known, so the middle snake itself isn't needed, and the search can be abandoned
+ * as soon as it's clear that the distance is larger than @a maxDistance.
+ */
+template <typename Index, typename Container>
+static Index editDistance(const Container &oldList, const Container &newList, const Slice<Index> &slice,
+                          Diagonals<Index> &forward, Diagonals<Index> &backward, Index maxDistance)
+{
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+
+    // At least the difference of both sizes has to be inserted or removed.
+    if (oldSize - newSize > maxDistance || newSize - oldSize > maxDistance) {
+        return maxDistance + 1;
+    }
+
+    if (oldSize < 1 || newSize < 1) {
+        return std::min<Index>(oldSize + newSize, maxDistance + 1);
+    }
+
+    const Index delta = oldSize - newSize;
+
+    const MiddleSnakeSearch<Index, Container> search{
+        .slice = slice,
+        .src = oldList,
+        .dst = newList,
+        .forward = forward,
+        .backward = backward,
+        .oldSize = oldSize,
+        .newSize = newSize,
+        .delta = delta,
+        .front = (delta % 2) != 0,
+    };
+
+    forward.reserve(1);
+    backward.reserve(1);
+
+    forward[1] = 0;
+    backward[1] = newSize;
+
+    // The forward paths can only overlap with the backward paths in the forward round d if
+    // delta is odd, which takes 2 * d - 1 edits, and in the backward round d otherwise,
+    // which takes 2 * d edits.
+    Snake<Index> snake;
+    for (Index d = 0; 2 * d - 1 <= maxDistance; ++d) {
+        forward.reserve(d + 1);
+        backward.reserve(d + 1);
+
+        if (search.forwardRound(d, snake)) {
+            return 2 * d - 1;
+        }
+        if (2 * d > maxDistance) {
+            break;
+        }
+        if (search.backwardRound(d, snake)) {
+            return 2 * d;
+        }
+    }
+
+    return maxDistance + 1;
+}
+
+/**
+ * Returns the number of insertions and removals needed to turn @a oldList into @a newList,
+ * or @a maxDistance + 1 if more than @a maxDistance edits are needed.
+ */
+template <typename Index, typename Container>
+static Index editDistance(const Container &oldList, const Container &newList,
+                          Diagonals<Index> &forward, Diagonals<Index> &backward, Index maxDistance)
+{
+    // At least the difference of both sizes has to be inserted or removed.
+    const Index sizeDifference = Index(oldList.size()) - Index(newList.size());
+    if (sizeDifference > maxDistance || -sizeDifference > maxDistance) {
+        return maxDistance + 1;
+    }
+
+    return editDistance(oldList, newList, trim<Index>(oldList, newList), forward, backward, maxDistance);
+}
+
+/**
+ * Lists longer than this are never diffed with the bit-parallel LCS algorithm.
+ */
+static constexpr qsizetype bitParallelMaxSize = 4096;
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the bit-parallel LCS
+ * algorithm by Allison, Dix and Hyyrö. Every row of the LCS table is stored as a bit vector,
+ * where bit i is cleared if the LCS grows when going from column i to column i + 1, and the
+ * edit path is recovered by walking the table backwards.
+ *
+ * If either part of the slice is empty or longer than bitParallelMaxSize items, @c false is
+ * returned without doing anything.
+ */
+template <typename Index, typename Container>
+static bool collectSnakesBitParallel(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                                     const Slice<Index> &slice)
+{
+    const Index oldSize = slice.x2 - slice.x1;
+    const Index newSize = slice.y2 - slice.y1;
+    if (oldSize < 1 || newSize < 1 || oldSize > bitParallelMaxSize || newSize > bitParallelMaxSize) {
+        return false;
+    }
+
+    using Item = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(oldList))>>;
+    static_assert(sizeof(Item) <= sizeof(quint64));
+    const auto key = [](const Item &item) {
+        quint64 result = 0;
+        std::memcpy(&result, &item, sizeof(Item));
+        return result;
+    };
+
+    // Map the items to symbols using an open addressing hash table that is at most half full.
+    // The items that don't appear in the old list get no symbol.
+    int bits = 1;
+    while ((Index(1) << bits) < 2 * oldSize) {
+        ++bits;
+    }
+    const Index mask = (Index(1) << bits) - 1;
+
+    std::vector<SymbolSlot<Index>> &symbols = buffers.symbols;
+    symbols.assign(mask + 1, SymbolSlot<Index>{.key = 0, .symbol = -1});
+    const auto lookup = [&](quint64 key) -> SymbolSlot<Index> & {
+        Index i = Index((key * 0x9e3779b97f4a7c15) >> (64 - bits));
+        while (symbols[i].symbol != -1 && symbols[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return symbols[i];
+    };
+
+    Index symbolCount = 0;
+    buffers.oldSymbols.resize(oldSize);
+    buffers.newSymbols.resize(newSize);
+    for (Index x = 0; x < oldSize; ++x) {
+        const quint64 item = key(std::data(oldList)[slice.x1 + x]);
+        SymbolSlot<Index> &slot = lookup(item);
+        if (slot.symbol == -1) {
+            slot.key = item;
+            slot.symbol = symbolCount++;
+        }
+        buffers.oldSymbols[x] = slot.symbol;
+    }
+    for (Index y = 0; y < newSize; ++y) {
+        buffers.newSymbols[y] = lookup(key(std::data(newList)[slice.y1 + y])).symbol;
+    }
+
+    const Index words = (oldSize + 63) / 64;
+
+    std::vector<quint64> &matchMasks = buffers.matchMasks;
+    matchMasks.assign(symbolCount * words, 0);
+    for (Index x = 0; x < oldSize; ++x) {
+        matchMasks[buffers.oldSymbols[x] * words + x / 64] |= quint64(1) << (x % 64);
+    }
+
+    // Row 0 corresponds to the empty prefix of the new list, so all bits are set.
+    std::vector<quint64> &rows = buffers.rows;
+    rows.resize((newSize + 1) * words);
+    std::fill_n(rows.begin(), words, ~quint64(0));
+
+    for (Index y = 0; y < newSize; ++y) {
+        const quint64 *previous = rows.data() + y * words;
+        quint64 *current = rows.data() + (y + 1) * words;
+        const Index symbol = buffers.newSymbols[y];
+        if (symbol == -1) {
+            std::copy_n(previous, words, current);
+            continue;
+        }
+
+        const quint64 *mask = matchMasks.data() + symbol * words;
+        quint64 carry = 0;
+        for (Index w = 0; w < words; ++w) {
+            const quint64 v = previous[w];
+            const quint64 u = v & mask[w];
+            const quint64 partial = v + u;
+            const quint64 sum = partial + carry;
+            carry = quint64(partial < v) | quint64(sum < partial);
+            current[w] = sum | (v & ~mask[w]);
+        }
+    }
+
+    // Returns the length of the LCS of the first x old items and the first y new items.
+    const auto lcs = [&](Index x, Index y) {
+        const quint64 *row = rows.data() + y * words;
+        Index ones = 0;
+        for (Index w = 0; w < x / 64; ++w) {
+            ones += qPopulationCount(row[w]);
+        }
+        if (x % 64) {
+            ones += qPopulationCount(row[x / 64] & ((quint64(1) << (x % 64)) - 1));
+        }
+        return x - ones;
+    };
+
+    buffers.oldChanged.assign(oldSize, 0);
+    buffers.newChanged.assign(newSize, 0);
+
+    Index x = oldSize;
+    Index y = newSize;
+    Index length = lcs(x, y);
+    while (x > 0 && y > 0) {
+        if (rows[y * words + (x - 1) / 64] & (quint64(1) << ((x - 1) % 64))) {
+            // The LCS doesn't change without the old item, so it can be removed.
+            buffers.oldChanged[--x] = 1;
+        } else if (lcs(x, y - 1) == length) {
+            buffers.newChanged[--y] = 1;
+        } else {
+            --x;
+            --y;
+            --length;
+        }
+    }
+    while (x > 0) {
+        buffers.oldChanged[--x] = 1;
+    }
+    while (y > 0) {
+        buffers.newChanged[--y] = 1;
+    }
+
+    collectSnakesFromChanges(buffers, slice);
+    return true;
+}
+
+/**
+ * Returns @c true if the caller has asked for a specific algorithm. In that case, no other
+ * algorithm is chosen automatically.
+ */
+static inline bool hasExplicitEngine(DiffOptions options)
+{
+    return options & (DiffOption::WuDiff | DiffOption::BitParallelDiff | DiffOption::HuntSzymanskiDiff);
+}
+
+/**
+ * Finds the insertions and removals in the specified @a slice using the bit-parallel or the
+ * O(NP) algorithm if either is requested or likely to be faster, and using the Myers'
+ * algorithm otherwise. The snakes found by the sequential Myers' algorithm are passed to
+ * @a output, the other ones are appended to the snake list in @a buffers.
+ */
+template <typename Index, typename Container, typename Output>
+static void collectSnakesAuto(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                              const Slice<Index> &slice, DiffOptions options, Index costLimit, int threadCount, Output &&output)
+{
+    const qsizetype oldSize = slice.x2 - slice.x1;
+    const qsizetype newSize = slice.y2 - slice.y1;
+
+    if (options & DiffOption::WuDiff) {
+        collectSnakesWu(buffers, oldList, newList, slice, std::numeric_limits<qsizetype>::max());
+        return;
+    }
+
+    if constexpr (HasBitwiseStorage<Container>::value) {
+        if (options & DiffOption::BitParallelDiff) {
+            if (collectSnakesBitParallel(buffers, oldList, newList, slice)) {
+                return;
+            }
+        } else if (!hasExplicitEngine(options) && oldSize > 0 && newSize > 0
+                   && oldSize <= bitParallelMaxSize && newSize <= bitParallelMaxSize) {
+            // The Myers' algorithm is faster when the edit distance is small compared to the
+            // number of words per row, so only switch if the distance turns out to be larger.
+            // The search is capped, so this costs as much as a cheap Myers' diff at most.
+            const Index words = Index((oldSize + 63) / 64);
+            if (editDistance(oldList, newList, slice, buffers.forward, buffers.backward, 4 * words) > 4 * words
+                && collectSnakesBitParallel(buffers, oldList, newList, slice)) {
+                return;
+            }
+        }
+    }
+
+    // The O(NP) algorithm only looks at the diagonals between the end points, and the ones
+    // within P of them, so it wins if the sizes differ a lot. Give up on it if the number of
+    // path nodes exceeds four times the size of the lists, i.e. P turns out to be large, too.
+    if (!hasExplicitEngine(options) && !(options & DiffOption::LimitCost) && std::abs(oldSize - newSize) >= 64) {
+        if (collectSnakesWu(buffers, oldList, newList, slice, 4 * (oldSize + newSize))) {
+            return;
+        }
+    }
+
+    if ((options & DiffOption::Parallel) && threadCount > 1 && oldSize + newSize >= parallelSliceCutoff) {
+        collectSnakesParallel(buffers, oldList, newList, slice, costLimit, threadCount);
+        return;
+    }
+
+    collectSnakes(buffers, oldList, newList, slice, costLimit, output);
+}
+
+/**
+ * Passes the edit operations corresponding to the snakes in @a buffers to @a sink, detecting
+ * moves if requested.
+ */
+template <typename Index, typename Container, typename Sink>
+static void emitOperations(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                           DiffOptions options, Sink &sink)
+{
+    if (options & DiffOption::DetectMoves) {
+        detectMoves(buffers, oldList, newList, sink);
+    } else {
+        emitSnakes(buffers, sink);
+    }
+}
+
+/**
+ * Returns the number of rounds after which diffPartial() gives up on finding the middle snake
+ * in the specified @a slice. If @a limit is 0, the limit is picked automatically.
+ */
+template <typename Index>
+static Index costLimit(DiffOptions options, qsizetype limit, const Slice<Index> &slice)
+{
+    if (!(options & DiffOption::LimitCost)) {
+        return std::numeric_limits<Index>::max();
+    }
+
+    if (limit > 0) {
+        return Index(std::min<qsizetype>(limit, std::numeric_limits<Index>::max()));
+    }
+
+    // Roughly the square root of the number of diagonals, but at least 4096, like GNU diff.
+    Index automaticLimit = 1;
+    for (qsizetype diagonals = (slice.x2 - slice.x1) + (slice.y2 - slice.y1) + 3; diagonals != 0; diagonals >>= 2) {
+        automaticLimit <<= 1;
+    }
+
+    return std::max<Index>(automaticLimit, 4096);
+}
+
+/**
+ * Calculates the difference between @a oldList and @a newList using the specified scratch
+ * @a buffers, and passes the resulting edit operations to @a sink in application order.
+ *
+ * Unless moves are detected, the snakes found by the Myers' algorithm are turned into edit
+ * operations right away, so the operations don't have to be stored anywhere.
+ */
+template <typename Index, typename Container, typename Sink>
+static void diff(Buffers<Index> &buffers, const Container &oldList, const Container &newList,
+                 DiffOptions options, qsizetype limit, int threadCount, Sink &sink)
+{
+    buffers.snakes.clear();
+
+    const bool streaming = !(options & DiffOption::DetectMoves);
+    const auto output = [&](const Snake<Index> &snake) {
+        if (streaming) {
+            emitSnake(snake, sink);
+        } else {
+            buffers.snakes.push_back(snake);
+        }
+    };
+
+    // Strip the common prefix and suffix first. Most of the time, the lists differ only in
+    // a few places, so this is much cheaper than following the snakes in diffPartial().
+    const Slice<Index> slice = trim<Index>(oldList, newList);
+    collectSnakesAuto(buffers, oldList, newList, slice, options, costLimit(options, limit, slice), threadCount, output);
+
+    emitOperations(buffers, oldList, newList, options, sink);
+}
+
+/**
+ * Calculates the difference between the interned lists in @a ids using the specified scratch
+ * @a buffers, and passes the resulting edit operations to @a sink in application order.
+ */
+template <typename Index, typename Sink>
+static void diffIds(Buffers<Index> &buffers, const ItemIds &ids, DiffOptions options, qsizetype limit, int threadCount,
+                    Sink &sink)
+{
+    buffers.snakes.clear();
+
+    const bool streaming = !(options & DiffOption::DetectMoves);
+    const auto output = [&](const Snake<Index> &snake) {
+        if (streaming) {
+            emitSnake(snake, sink);
+        } else {
+            buffers.snakes.push_back(snake);
+        }
+    };
+
+    const Slice<Index> slice = trim<Index>(ids.oldIds, ids.newIds);
+    if (options & DiffOption::HistogramDiff) {
+        collectSnakesHistogram(buffers, ids, slice, costLimit(options, limit, slice));
+    } else if (options & DiffOption::PatienceDiff) {
+        collectSnakesPatience(buffers, ids, slice, costLimit(options, limit, slice));
+    } else if (options & DiffOption::DiscardConfusingItems) {
+        collectSnakesDiscarding(buffers, ids, slice, costLimit(options, limit, slice));
+    } else {
+        const bool huntSzymanski = (options & DiffOption::HuntSzymanskiDiff) || !hasExplicitEngine(options);
+        if (!huntSzymanski || !collectSnakesHuntSzymanski(buffers, ids, slice, bool(options & DiffOption::HuntSzymanskiDiff))) {
+            collectSnakesAuto(buffers, ids.oldIds, ids.newIds, slice, options, costLimit(options, limit, slice), threadCount, output);
+        }
+    }
+
+    emitOperations(buffers, ids.oldIds, ids.newIds, options, sink);
+}
+
+/**
+ * Appends @a value to @a data as a LEB128 varint, i.e. 7 bits per byte, least significant
+ * bits first, with the high bit set in all bytes but the last one.
+ */
+static inline void appendVarint(std::vector<quint8> &data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.push_back(quint8(value) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(quint8(value));
+}
+
+/**
+ * Reads a varint written by appendVarint() at @a position and advances @a position past it.
+ */
+static inline quint64 readVarint(const quint8 *&position)
+{
+    quint64 value = 0;
+    for (int shift = 0;; shift += 7) {
+        const quint8 byte = *position++;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+/**
+ * Maps signed values to unsigned ones so that values close to zero stay small, i.e.
+ * 0, -1, 1, -2, 2, ... become 0, 1, 2, 3, 4, ...
+ */
+static inline quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+static inline qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+/**
+ * Resolves to @c void if @c Sink can be called with an edit operation, which makes the diff()
+ * overloads taking a sink distinguishable from the ones taking diff options.
+ */
+template <typename Sink>
+using EnableIfSink = std::enable_if_t<std::is_invocable_v<Sink &, const EditOperation &>>;
+
+/**
+ * The BatchEntry struct records where the edit operations of one pair of a batch have been
+ * stored, i.e. the worker that has diffed the pair and the range in its operation list.
+ */
+struct BatchEntry
+{
+    int worker;
+    qsizetype first;
+    qsizetype last;
+};
+
+} // namespace Private
+
+/**
+ * The EditScript class is a compact alternative to a list of EditOperation objects.
+ *
+ * Every operation is stored as one opcode byte followed by varint operands. Positions are
+ * delta encoded against the previous operation, which, given that operations are usually
+ * close to each other, makes a typical operation take 2 to 5 bytes instead of the 32 bytes
+ * of an EditOperation.
+ *
+ * An edit script can be passed to diff() as a sink, which appends the edit operations to it.
+ * The operations can be read back either with an iterator, which decodes them to
+ * EditOperation objects, or with visit(), which avoids the variant altogether.
+ */
+class EditScript
+{
+    enum Opcode : quint8 {
+        Insert = 0,
+        Remove = 1,
+        Move = 2,
+        TypeMask = 0x3,
+        SingleItem = 0x4, ///< The count is 1 and is not stored.
+    };
+
+    /**
+     * The positions of the previously encoded or decoded operation.
+     */
+    struct Cursor
+    {
+        qsizetype oldPosition = 0;
+        qsizetype newPosition = 0;
+    };
+
+public:
+    /**
+     * The const_iterator class is a forward iterator that decodes the operations of an
+     * EditScript one by one.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = EditOperation;
+        using difference_type = qsizetype;
+        using pointer = const EditOperation *;
+        using reference = const EditOperation &;
+
+        const_iterator() = default;
+
+        reference operator*() const
+        {
+            return m_current;
+        }
+
+        pointer operator->() const
+        {
+            return &m_current;
+        }
+
+        const_iterator &operator++()
+        {
+            m_position = m_next;
+            decode();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator &other) const
+        {
+            return m_position == other.m_position;
+        }
+
+        bool operator!=(const const_iterator &other) const
+        {
+            return m_position != other.m_position;
+        }
+
+    private:
+        const_iterator(const quint8 *position, const quint8 *end)
+            : m_position(position)
+            , m_next(position)
+            , m_end(end)
+        {
+            decode();
+        }
+
+        void decode()
+        {
+            if (m_position != m_end) {
+                m_next = m_position;
+                EditScript::decode(m_next, m_cursor, [this](const auto &operation) {
+                    m_current = operation;
+                });
+            }
+        }
+
+        const quint8 *m_position = nullptr;
+        const quint8 *m_next = nullptr;
+        const quint8 *m_end = nullptr;
+        Cursor m_cursor;
+        EditOperation m_current;
+
+        friend class EditScript;
+    };
+
+    /**
+     * Returns the number of operations in the script.
+     */
+    qsizetype size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Returns @c true if the script contains no operations.
+     */
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * Returns the number of bytes used to encode the operations.
+     */
+    qsizetype byteSize() const
+    {
+        return m_data.size();
+    }
+
+    /**
+     * Removes all operations. The memory is kept for reuse.
+     */
+    void clear()
+    {
+        m_data.clear();
+        m_size = 0;
+        m_cursor = Cursor();
+    }
+
+    /**
+     * Releases the memory that is not needed to store the current operations.
+     */
+    void squeeze()
+    {
+        m_data.shrink_to_fit();
+    }
+
+    /**
+     * Appends the specified @a operation to the end of the script.
+     */
+    void append(const EditOperation &operation)
+    {
+        if (auto insert = std::get_if<InsertOperation>(&operation)) {
+            appendOpcode(Insert, insert->count);
+            Private::appendVarint(m_data, Private::zigzag(insert->index - m_cursor.oldPosition));
+            Private::appendVarint(m_data, Private::zigzag(insert->offset - m_cursor.newPosition));
+            appendCount(insert->count);
+            m_cursor.oldPosition = insert->index;
+            m_cursor.newPosition = insert->offset;
+        } else if (auto remove = std::get_if<RemoveOperation>(&operation)) {
+            appendOpcode(Remove, remove->count);
+            Private::appendVarint(m_data, Private::zigzag(remove->offset - m_cursor.oldPosition));
+            appendCount(remove->count);
+            m_cursor.oldPosition = remove->offset;
+        } else if (auto move = std::get_if<MoveOperation>(&operation)) {
+            appendOpcode(Move, move->count);
+            Private::appendVarint(m_data, Private::zigzag(move->from - m_cursor.oldPosition));
+            Private::appendVarint(m_data, Private::zigzag(move->to - move->from));
+            appendCount(move->count);
+            m_cursor.oldPosition = move->from;
+        }
+        ++m_size;
+    }
+
+    /**
+     * Appends the specified @a operation to the end of the script. This makes it possible to
+     * pass an EditScript to diff() as a sink.
+     */
+    void operator()(const EditOperation &operation)
+    {
+        append(operation);
+    }
+
+    /**
+     * Calls @a visitor with every operation in the script, in order. The @a visitor is called
+     * with an InsertOperation, a RemoveOperation or a MoveOperation, so it must be callable
+     * with all three types, e.g. a generic lambda or a struct with overloaded call operators.
+     */
+    template <typename Visitor>
+    void visit(Visitor &&visitor) const
+    {
+        Cursor cursor;
+        const quint8 *position = m_data.data();
+        const quint8 *end = position + m_data.size();
+        while (position != end) {
+            decode(position, cursor, visitor);
+        }
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(m_data.data(), m_data.data() + m_data.size());
+    }
+
+    const_iterator end() const
+    {
+        const quint8 *end = m_data.data() + m_data.size();
+        return const_iterator(end, end);
+    }
+
+private:
+    void appendOpcode(Opcode type, qsizetype count)
+    {
+        m_data.push_back(count == 1 ? quint8(type | SingleItem) : quint8(type));
+    }
+
+    void appendCount(qsizetype count)
+    {
+        if (count != 1) {
+            Private::appendVarint(m_data, quint64(count));
+        }
+    }
+
+    template <typename Visitor>
+    static void decode(const quint8 *&position, Cursor &cursor, Visitor &&visitor)
+    {
+        const quint8 opcode = *position++;
+        switch (opcode & TypeMask) {
+        case Insert: {
+            cursor.oldPosition += Private::unzigzag(Private::readVarint(position));
+            cursor.newPosition += Private::unzigzag(Private::readVarint(position));
+            visitor(InsertOperation{
+                .index = cursor.oldPosition,
+                .offset = cursor.newPosition,
+                .count = readCount(position, opcode),
+            });
+            break;
+        }
+        case Remove: {
+            cursor.oldPosition += Private::unzigzag(Private::readVarint(position));
+            visitor(RemoveOperation{
+                .offset = cursor.oldPosition,
+                .count = readCount(position, opcode),
+            });
+            break;
+        }
+        case Move: {
+            cursor.oldPosition += Private::unzigzag(Private::readVarint(position));
+            const qsizetype to = cursor.oldPosition + Private::unzigzag(Private::readVarint(position));
+            visitor(MoveOperation{
+                .from = cursor.oldPosition,
+                .to = to,
+                .count = readCount(position, opcode),
+            });
+            break;
+        }
+        default:
+            Q_UNREACHABLE();
+        }
+    }
+
+    static qsizetype readCount(const quint8 *&position, quint8 opcode)
+    {
+        return (opcode & SingleItem) ? 1 : qsizetype(Private::readVarint(position));
+    }
+
+    std::vector<quint8> m_data;
+    qsizetype m_size = 0;
+    Cursor m_cursor;
+};
+
+class DiffWorkspace;
+class DiffBatch;
+
+template <typename Container>
+static const std::vector<EditOperation> &diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, DiffOptions options = DiffOptions());
+
+template <typename Container>
+static std::vector<EditOperation> diff(const Container &oldList, const Container &newList, DiffOptions options = DiffOptions());
+
+template <typename Container, typename Sink>
+static Private::EnableIfSink<Sink> diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, Sink &&sink, DiffOptions options = DiffOptions());
+
+template <typename Container, typename Sink>
+static Private::EnableIfSink<Sink> diff(const Container &oldList, const Container &newList, Sink &&sink, DiffOptions options = DiffOptions());
+
+template <typename Pairs>
+static const DiffBatch &diffBatch(DiffWorkspace &workspace, const Pairs &pairs, DiffOptions options = DiffOptions());
+
+template <typename Pairs>
+static DiffBatch diffBatch(const Pairs &pairs, DiffOptions options = DiffOptions());
+
+/**
+ * The DiffBatch class holds the edit operations of many diffs, as returned by diffBatch().
+ *
+ * All operations are stored in one flat list. The operations of the pair i occupy the range
+ * [offsets()[i], offsets()[i + 1]) of operations(), in the order in which they must be
+ * applied, which saves allocating a list per pair.
+ */
+class DiffBatch
+{
+public:
+    /**
+     * The Range class refers to the edit operations of one pair.
+     */
+    class Range
+    {
+    public:
+        const EditOperation *begin() const
+        {
+            return m_begin;
+        }
+
+        const EditOperation *end() const
+        {
+            return m_end;
+        }
+
+        qsizetype size() const
+        {
+            return m_end - m_begin;
+        }
+
+        bool empty() const
+        {
+            return m_begin == m_end;
+        }
+
+    private:
+        Range(const EditOperation *begin, const EditOperation *end)
+            : m_begin(begin)
+            , m_end(end)
+        {
+        }
+
+        const EditOperation *m_begin;
+        const EditOperation *m_end;
+
+        friend class DiffBatch;
+    };
+
+    /**
+     * Returns the number of diffed pairs.
+     */
+    qsizetype size() const
+    {
+        return qsizetype(m_offsets.size()) - 1;
+    }
+
+    /**
+     * Returns the edit operations of the pair with the specified @a index.
+     */
+    Range operator[](qsizetype index) const
+    {
+        const EditOperation *operations = m_operations.data();
+        return Range(operations + m_offsets[index], operations + m_offsets[index + 1]);
+    }
+
+    /**
+     * Returns the start of the operations of every pair, followed by the total number of
+     * operations.
+     */
+    const std::vector<qsizetype> &offsets() const
+    {
+        return m_offsets;
+    }
+
+    /**
+     * Returns the edit operations of all pairs.
+     */
+    const std::vector<EditOperation> &operations() const
+    {
+        return m_operations;
+    }
+
+private:
+    std::vector<qsizetype> m_offsets = {0};
+    std::vector<EditOperation> m_operations;
+
+    friend class DiffWorkspace;
+};
+
+/**
+ * The DiffWorkspace class holds the scratch buffers used by diff().
+ *
+ * The buffers are grown on demand and kept between calls, so if diff() is called often, e.g.
+ * every time a model is refreshed, passing the same workspace to every call avoids allocating
+ * memory once the workspace has grown large enough for the typical input. The only exception
+ * is DiffOption::Parallel, which starts its threads anew for every call that uses them.
+ *
+ * A workspace must not be used by several threads at the same time.
+ */
+class DiffWorkspace
+{
+public:
+    /**
+     * Returns the number of rounds of the middle snake search after which the search is
+     * abandoned if DiffOption::LimitCost is specified. If the limit is 0, which is the
+     * default, it is chosen automatically based on the size of the lists.
+     */
+    qsizetype costLimit() const
+    {
+        return m_costLimit;
+    }
+
+    /**
+     * Sets the cost limit to @a limit. Lower values make diff() faster for lists that are
+     * very different, at the expense of producing longer sequences of edit operations.
+     */
+    void setCostLimit(qsizetype limit)
+    {
+        m_costLimit = limit;
+    }
+
+    /**
+     * Returns the number of threads used if DiffOption::Parallel is specified. By default,
+     * it's the number of hardware threads.
+     */
+    int threadCount() const
+    {
+        if (m_threadCount > 0) {
+            return m_threadCount;
+        }
+        return std::max(1, int(std::thread::hardware_concurrency()));
+    }
+
+    /**
+     * Sets the number of threads used if DiffOption::Parallel is specified to @a count. If
+     * @a count is 0, the number of hardware threads is used.
+     */
+    void setThreadCount(int count)
+    {
+        m_threadCount = count;
+    }
+
+    /**
+     * Releases all memory held by the workspace.
+     */
+    void squeeze()
+    {
+        m_narrow = {};
+        m_wide = {};
+        m_itemIds.squeeze();
+        m_oldIds = {};
+        m_newIds = {};
+        m_editOperations = {};
+        m_batch = {};
+        m_batchOrder = {};
+        m_batchEntries = {};
+        m_workers.clear();
+        m_workers.shrink_to_fit();
+    }
+
+private:
+    /**
+     * Runs @a run(workspace, index, sink) for every index in range [0, @a count), and stores
+     * the edit operations passed to the sink in the batch of this workspace. If the diffs are
+     * distributed over several threads, the largest ones according to @a cost go first.
+     */
+    template <typename Cost, typename Run>
+    const DiffBatch &diffMany(qsizetype count, DiffOptions options, const Cost &cost, const Run &run)
+    {
+        int workerCount = 1;
+        if (options & DiffOption::Parallel) {
+            workerCount = int(std::clamp<qsizetype>(count, 1, threadCount()));
+        }
+
+        while (int(m_workers.size()) < workerCount) {
+            m_workers.push_back(std::make_unique<DiffWorkspace>());
+        }
+
+        std::vector<qsizetype> &order = m_batchOrder;
+        order.resize(count);
+        for (qsizetype i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        if (workerCount > 1) {
+            std::stable_sort(order.begin(), order.end(), [&cost](qsizetype a, qsizetype b) {
+                return cost(a) > cost(b);
+            });
+        }
+
+        std::vector<Private::BatchEntry> &entries = m_batchEntries;
+        entries.resize(count);
+
+        std::atomic<qsizetype> next(0);
+        const auto work = [&](int id) {
+            DiffWorkspace &local = *m_workers[id];
+            local.m_costLimit = m_costLimit;
+            local.m_threadCount = 1;
+
+            std::vector<EditOperation> &operations = local.m_editOperations;
+            operations.clear();
+
+            const auto sink = [&operations](const EditOperation &operation) {
+                operations.push_back(operation);
+            };
+
+            for (qsizetype i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed)) {
+                const qsizetype index = order[i];
+                const qsizetype first = operations.size();
+                run(local, index, sink);
+                entries[index] = Private::BatchEntry{.worker = id, .first = first, .last = qsizetype(operations.size())};
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workerCount - 1);
+        for (int id = 1; id < workerCount; ++id) {
+            threads.emplace_back(work, id);
+        }
+        work(0);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        DiffBatch &batch = m_batch;
+        batch.m_offsets.resize(count + 1);
+        batch.m_offsets[0] = 0;
+        for (qsizetype i = 0; i < count; ++i) {
+            batch.m_offsets[i + 1] = batch.m_offsets[i] + (entries[i].last - entries[i].first);
+        }
+
+        // A single worker has run the diffs in order, so its list can be taken as it is.
+        if (workerCount == 1) {
+            batch.m_operations.swap(m_workers[0]->m_editOperations);
+        } else {
+            batch.m_operations.clear();
+            batch.m_operations.reserve(batch.m_offsets[count]);
+            for (qsizetype i = 0; i < count; ++i) {
+                const std::vector<EditOperation> &operations = m_workers[entries[i].worker]->m_editOperations;
+                batch.m_operations.insert(batch.m_operations.end(), operations.begin() + entries[i].first, operations.begin() + entries[i].last);
+            }
+        }
+
+        return batch;
+    }
+
+    /**
+     * Returns the scratch buffers for the specified @c Index type.
+     */
+    template <typename Index>
+    Private::Buffers<Index> &buffers()
+    {
+        if constexpr (std::is_same_v<Index, qint32>) {
+            return m_narrow;
+        } else {
+            return m_wide;
+        }
+    }
+
+    Private::Buffers<qint32> m_narrow;
+    Private::Buffers<qsizetype> m_wide;
+    Private::ItemTable m_itemIds;
+    std::vector<quint32> m_oldIds;
+    std::vector<quint32> m_newIds;
+    std::vector<EditOperation> m_editOperations;
+    qsizetype m_costLimit = 0;
+    int m_threadCount = 0;
+
+    // Used by diffBatch().
+    DiffBatch m_batch;
+    std::vector<qsizetype> m_batchOrder;
+    std::vector<Private::BatchEntry> m_batchEntries;
+    std::vector<std::unique_ptr<DiffWorkspace>> m_workers;
+
+    template <typename Container>
+    friend const std::vector<EditOperation> &diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, DiffOptions options);
+    template <typename Container>
+    friend std::vector<EditOperation> diff(const Container &oldList, const Container &newList, DiffOptions options);
+    template <typename Container, typename Sink>
+    friend Private::EnableIfSink<Sink> diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, Sink &&sink, DiffOptions options);
+    template <typename Pairs>
+    friend const DiffBatch &diffBatch(DiffWorkspace &workspace, const Pairs &pairs, DiffOptions options);
+    template <typename Pairs>
+    friend DiffBatch diffBatch(const Pairs &pairs, DiffOptions options);
+    template <typename Container>
+    friend class DiffBaseline;
+};
+
+/**
+ * This function calculates the difference between two specified lists. That's it, the
+ * sequence of insert and remove operations that will transform the @a oldList into @a newList.
+ *
+ * If two lists are the same, an empty list will be returned. The first operation in the
+ * returned list must be applied first, and the last one must be applied last.
+ *
+ * By default, this function uses the Myers' diff algorithm to calculate the difference,
+ * which produces the shortest edit script. Unless one of the algorithms is forced with
+ * @a options, a faster algorithm that finds an equally short script is chosen automatically
+ * for some inputs: the O(NP) algorithm if the sizes of the lists differ substantially, the
+ * bit-parallel LCS algorithm for short lists that differ a lot, and the Hunt-Szymanski
+ * algorithm for interned lists with only a few items in common. See DiffOption for details.
+ * If the lists are small enough, 32-bit indices are used in order to halve the size of
+ * the scratch buffers.
+ *
+ * Move detection takes O(n log n) time, where n is the number of inserted and removed items.
+ */
+template <typename Container>
+static std::vector<EditOperation> diff(const Container &oldList, const Container &newList, DiffOptions options)
+{
+    DiffWorkspace workspace;
+    diff(workspace, oldList, newList, options);
+    return std::move(workspace.m_editOperations);
+}
+
+/**
+ * This is an overloaded function. The scratch buffers are taken from the specified @a workspace,
+ * and the returned list is owned by it, too. The returned list stays valid until the workspace
+ * is used again or destroyed.
+ */
+template <typename Container>
+static const std::vector<EditOperation> &diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, DiffOptions options)
+{
+    std::vector<EditOperation> &editOperations = workspace.m_editOperations;
+    editOperations.clear();
+
+    diff(workspace, oldList, newList, [&editOperations](const EditOperation &operation) {
+        editOperations.push_back(operation);
+    }, options);
+
+    return editOperations;
+}
+
+/**
+ * This is an overloaded function. Instead of being stored in a list, the edit operations are
+ * passed to @a sink one by one, in the order in which they must be applied. The @a sink is
+ * called with a const reference to an EditOperation.
+ *
+ * Unless moves are detected, most operations are passed to the @a sink as soon as they are
+ * found, so a large diff can be fed to a serializer or a model without materializing the
+ * whole list of edit operations first.
+ */
+template <typename Container, typename Sink>
+static Private::EnableIfSink<Sink> diff(DiffWorkspace &workspace, const Container &oldList, const Container &newList, Sink &&sink, DiffOptions options)
+{
+    // Looking up the number of hardware threads is a system call, so only do it if needed.
+    const int threadCount = (options & DiffOption::Parallel) ? workspace.threadCount() : 1;
+
+    Private::withIndexType(oldList.size(), newList.size(), [&](auto index) {
+        auto &buffers = workspace.buffers<decltype(index)>();
+        if (options & (DiffOption::InternItems | DiffOption::DiscardConfusingItems | DiffOption::PatienceDiff | DiffOption::HistogramDiff
+                       | DiffOption::HuntSzymanskiDiff)) {
+            const quint32 count = Private::intern(oldList, newList, workspace.m_itemIds, workspace.m_oldIds, workspace.m_newIds);
+            const Private::ItemIds ids{
+                .oldIds = workspace.m_oldIds,
+                .newIds = workspace.m_newIds,
+                .count = count,
+            };
+            Private::diffIds(buffers, ids, options, workspace.m_costLimit, threadCount, sink);
+        } else {
+            Private::diff(buffers, oldList, newList, options, workspace.m_costLimit, threadCount, sink);
+        }
+    });
+}
+
+/**
+ * This is an overloaded function. The edit operations are passed to @a sink using a temporary
+ * workspace.
+ */
+template <typename Container, typename Sink>
+static Private::EnableIfSink<Sink> diff(const Container &oldList, const Container &newList, Sink &&sink, DiffOptions options)
+{
+    DiffWorkspace workspace;
+    diff(workspace, oldList, newList, sink, options);
+}
+
+/**
+ * Calculates the differences between the lists of every pair in @a pairs, which is a random
+ * access container of pairs, e.g. std::pair, with the old list as @c first and the new list
+ * as @c second. The result is equivalent to calling diff() with the same @a options for
+ * every pair, but all edit operations end up in one DiffBatch and the scratch buffers are
+ * shared by all pairs, so diffing many small lists is much cheaper.
+ *
+ * If DiffOption::Parallel is specified, the pairs are distributed over the threads of the
+ * workspace, and each thread uses a workspace of its own. The pairs are handed out in the
+ * order of decreasing total size, so that no thread is left with a large diff at the end.
+ * The lists of one pair are always diffed on one thread.
+ *
+ * The returned batch is owned by the @a workspace and stays valid until the workspace is
+ * used again or destroyed.
+ */
+template <typename Pairs>
+static const DiffBatch &diffBatch(DiffWorkspace &workspace, const Pairs &pairs, DiffOptions options)
+{
+    const auto cost = [&pairs](qsizetype index) {
+        return qsizetype(std::size(pairs[index].first)) + qsizetype(std::size(pairs[index].second));
+    };
+    const auto run = [&pairs, options](DiffWorkspace &local, qsizetype index, const auto &sink) {
+        diff(local, pairs[index].first, pairs[index].second, sink, options);
+    };
+    return workspace.diffMany(std::size(pairs), options, cost, run);
+}
+
+/**
+ * This is an overloaded function. The pairs are diffed using a temporary workspace.
+ */
+template <typename Pairs>
+static DiffBatch diffBatch(const Pairs &pairs, DiffOptions options)
+{
+    DiffWorkspace workspace;
+    diffBatch(workspace, pairs, options);
+    return std::move(workspace.m_batch);
+}
+
+/**
+ * The DiffBaseline class prepares a list for being diffed against many other lists, e.g.
+ * one snapshot against many later versions of it.
+ *
+ * If items are interned, see DiffOption::InternItems, the items of the old list are hashed
+ * and interned once, the first time the baseline is used with an option that interns items.
+ * Without such options, the items are never hashed. Diffing a new list against the baseline
+ * then only looks up the items of the new list that are not part of the common prefix and
+ * suffix, and all items that don't appear in the old list get the same id, as they can't
+ * match anything. So the cost of a diff only depends on the size of the new list and the
+ * number of differences. Without interning, the lists are diffed as they are.
+ *
+ * The baseline refers to the old list, so the old list must not be changed or destroyed
+ * while the baseline is in use. A baseline can be used by several threads at the
+ * same time, as long as each of them uses its own workspace.
+ */
+template <typename Container>
+class DiffBaseline
+{
+    using Item = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(std::declval<const Container &>()))>>;
+
+public:
+    /**
+     * Constructs a baseline for diffing the specified @a oldList against other lists.
+     */
+    explicit DiffBaseline(const Container &oldList)
+        : m_oldList(oldList)
+    {
+    }
+
+    /**
+     * Returns the number of items in the old list.
+     */
+    qsizetype size() const
+    {
+        return m_oldList.size();
+    }
+
+    /**
+     * Calculates the difference between the old list and @a newList. The result is the same
+     * as the one of the diff() function with the same @a options.
+     *
+     * The returned list is owned by the @a workspace and stays valid until the workspace is
+     * used again or destroyed.
+     */
+    const std::vector<EditOperation> &diff(DiffWorkspace &workspace, const Container &newList, DiffOptions options = DiffOptions()) const
+    {
+        std::vector<EditOperation> &editOperations = workspace.m_editOperations;
+        editOperations.clear();
+
+        diff(workspace, newList, [&editOperations](const EditOperation &operation) {
+            editOperations.push_back(operation);
+        }, options);
+
+        return editOperations;
+    }
+
+    /**
+     * This is an overloaded function. The edit operations are returned in a new list.
+     */
+    std::vector<EditOperation> diff(const Container &newList, DiffOptions options = DiffOptions()) const
+    {
+        DiffWorkspace workspace;
+        diff(workspace, newList, options);
+        return std::move(workspace.m_editOperations);
+    }
+
+    /**
+     * This is an overloaded function. The edit operations are passed to @a sink one by one,
+     * in the order in which they must be applied.
+     */
+    template <typename Sink>
+    Private::EnableIfSink<Sink> diff(DiffWorkspace &workspace, const Container &newList, Sink &&sink, DiffOptions options = DiffOptions()) const
+    {
+        const int threadCount = (options & DiffOption::Parallel) ? workspace.threadCount() : 1;
+        const bool interned = options & (DiffOption::InternItems | DiffOption::DiscardConfusingItems | DiffOption::PatienceDiff
+                                         | DiffOption::HistogramDiff | DiffOption::HuntSzymanskiDiff);
+
+        Private::withIndexType(m_oldList.size(), newList.size(), [&](auto index) {
+            auto &buffers = workspace.buffers<decltype(index)>();
+            if (interned) {
+                intern();
+                const Private::ItemIds ids{
+                    .oldIds = m_oldIds,
+                    .newIds = lookup(workspace.m_newIds, newList),
+                    .count = quint32(m_ids.size()) + 1,
+                };
+                Private::diffIds(buffers, ids, options, workspace.m_costLimit, threadCount, sink);
+            } else {
+                Private::diff(buffers, m_oldList, newList, options, workspace.m_costLimit, threadCount, sink);
+            }
+        });
+    }
+
+    /**
+     * Calculates the differences between the old list and every list in @a newLists, which is
+     * a random access container. The edit operations of the list i end up in the range i of
+     * the returned batch. If DiffOption::Parallel is specified, the lists are distributed over
+     * the threads of the workspace, like with diffBatch().
+     *
+     * The returned batch is owned by the @a workspace and stays valid until the workspace is
+     * used again or destroyed.
+     */
+    template <typename Lists>
+    const DiffBatch &diffBatch(DiffWorkspace &workspace, const Lists &newLists, DiffOptions options = DiffOptions()) const
+    {
+        const auto cost = [&newLists](qsizetype index) {
+            return qsizetype(std::size(newLists[index]));
+        };
+        const auto run = [this, &newLists, options](DiffWorkspace &local, qsizetype index, const auto &sink) {
+            diff(local, newLists[index], sink, options);
+        };
+        return workspace.diffMany(std::size(newLists), options, cost, run);
+    }
+
+    /**
+     * This is an overloaded function. The lists are diffed using a temporary workspace.
+     */
+    template <typename Lists>
+    DiffBatch diffBatch(const Lists &newLists, DiffOptions options = DiffOptions()) const
+    {
+        DiffWorkspace workspace;
+        diffBatch(workspace, newLists, options);
+        return std::move(workspace.m_batch);
+    }
+
+private:
+    /**
+     * Interns the items of the old list, unless that has been done already. Several threads
+     * may call this at the same time, the items are interned only once.
+     */
+    void intern() const
+    {
+        std::call_once(m_interned, [this]() {
+            m_ids.reserve(m_oldList.size());
+            m_oldIds.reserve(m_oldList.size());
+            for (const Item &item : m_oldList) {
+                m_oldIds.push_back(m_ids.try_emplace(&item, quint32(m_ids.size())).first->second);
+            }
+        });
+    }
+
+    /**
+     * Stores the ids of the items in @a newList in @a newIds, and returns them. The items in
+     * the common prefix and suffix take the ids of the matching old items without a lookup.
+     */
+    const std::vector<quint32> &lookup(std::vector<quint32> &newIds, const Container &newList) const
+    {
+        const Private::Slice<qsizetype> slice = Private::trim<qsizetype>(m_oldList, newList);
+        const qsizetype newSize = newList.size();
+        const quint32 unknown = quint32(m_ids.size());
+
+        newIds.resize(newSize);
+        std::copy(m_oldIds.begin(), m_oldIds.begin() + slice.x1, newIds.begin());
+        std::copy(m_oldIds.begin() + slice.x2, m_oldIds.end(), newIds.begin() + slice.y2);
+
+        auto item = std::begin(newList) + slice.y1;
+        for (qsizetype y = slice.y1; y < slice.y2; ++y, ++item) {
+            const auto it = m_ids.find(&*item);
+            newIds[y] = it == m_ids.end() ? unknown : it->second;
+        }
+
+        return newIds;
+    }
+
+    const Container &m_oldList;
+    mutable std::once_flag m_interned;
+    mutable std::unordered_map<const Item *, quint32, Private::ItemHash<Item>, Private::ItemEqual<Item>> m_ids;
+    mutable std::vector<quint32> m_oldIds;
+};
+
+/**
+ * Returns the number of items that have to be inserted or removed in order to transform
+ * @a oldList into @a newList, i.e. the total count of the edit operations returned by diff()
+ * without move detection.
+ *
+ * This is much cheaper than calling diff() and summing up the counts, as only the first
+ * middle snake search of the Myers' algorithm is run and no edit operations are built. The
+ * memory usage is proportional to the distance rather than to the size of the lists.
+ */
+template <typename Container>
+static qsizetype editDistance(const Container &oldList, const Container &newList)
+{
+    const qsizetype oldSize = oldList.size();
+    const qsizetype newSize = newList.size();
+
+    return Private::withIndexType(oldSize, newSize, [&](auto index) {
+        using Index = decltype(index);
+        Private::Diagonals<Index> forward, backward;
+        return qsizetype(Private::editDistance<Index>(oldList, newList, forward, backward, oldSize + newSize));
+    });
+}
+
+/**
+ * Returns the similarity of @a oldList and @a newList, ranging from 0 if they have no items
+ * in common to 1 if they are equal. It's computed as twice the number of common items
+ * divided by the total number of items, as in Python's difflib.
+ */
+template <typename Container>
+static qreal similarity(const Container &oldList, const Container &newList)
+{
+    const qsizetype size = qsizetype(oldList.size()) + qsizetype(newList.size());
+    if (size == 0) {
+        return 1;
+    }
+
+    return 1 - qreal(editDistance(oldList, newList)) / size;
+}
+
+/**
+ * Returns @c true if @a oldList can be transformed into @a newList with at most @a distance
+ * insertions and removals.
+ *
+ * This is cheaper than comparing editDistance() with @a distance, because the search stops
+ * as soon as it's known that more edits are needed. If the sizes of the lists differ by more
+ * than @a distance, no items are compared at all. The time complexity is O((N + M) * distance).
+ */
+template <typename Container>
+static bool withinDistance(const Container &oldList, const Container &newList, qsizetype distance)
+{
+    if (distance < 0) {
+        return false;
+    }
+
+    const qsizetype oldSize = oldList.size();
+    const qsizetype newSize = newList.size();
+    if (std::abs(oldSize - newSize) > distance) {
+        return false;
+    }
+
+    return Private::withIndexType(oldSize, newSize, [&](auto index) {
+        using Index = decltype(index);
+        const Index maxDistance = std::min(distance, oldSize + newSize);
+        Private::Diagonals<Index> forward, backward;
+        return Private::editDistance<Index>(oldList, newList, forward, backward, maxDistance) <= maxDistance;
+    });
+}
+
+/**
+ * The DiffRange class computes the difference between two lists lazily. The edit operations
+ * are produced one at a time, in the order in which they must be applied, as the range is
+ * iterated, so a consumer that stops early, e.g. after showing the first few changes, only
+ * pays for the operations it has looked at.
+ *
+ * The range keeps references to the lists, so they must outlive it. The operations are
+ * computed by the Myers' algorithm as they are requested, so none of the DiffOption values
+ * apply, except for the cost limit, which can be passed to the constructor.
+ *
+ * A DiffRange can be iterated only once.
+ */
+template <typename Container>
+class DiffRange
+{
+public:
+    /**
+     * The iterator class is an input iterator over the edit operations of a DiffRange.
+     */
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = EditOperation;
+        using difference_type = qsizetype;
+        using pointer = const EditOperation *;
+        using reference = const EditOperation &;
+
+        iterator() = default;
+
+        reference operator*() const
+        {
+            return m_range->m_current;
+        }
+
+        pointer operator->() const
+        {
+            return &m_range->m_current;
+        }
+
+        iterator &operator++()
+        {
+            m_range->advance();
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const
+        {
+            return atEnd() == other.atEnd();
+        }
+
+        bool operator!=(const iterator &other) const
+        {
+            return atEnd() != other.atEnd();
+        }
+
+    private:
+        explicit iterator(DiffRange *range)
+            : m_range(range)
+        {
+        }
+
+        bool atEnd() const
+        {
+            return !m_range || m_range->m_finished;
+        }
+
+        DiffRange *m_range = nullptr;
+
+        friend class DiffRange;
+    };
+
+    /**
+     * Constructs a range over the edit operations that transform @a oldList into @a newList.
+     *
+     * If @a costLimit is positive, the middle snake search is abandoned after that many
+     * rounds, as with DiffOption::LimitCost. If it's 0, the limit is chosen automatically
+     * based on the size of the lists. If it's negative, which is the default, the search
+     * always runs to completion.
+     */
+    DiffRange(const Container &oldList, const Container &newList, qsizetype costLimit = -1)
+        : m_oldList(oldList)
+        , m_newList(newList)
+    {
+        const DiffOptions options = costLimit < 0 ? DiffOptions() : DiffOptions(DiffOption::LimitCost);
+
+        Private::withIndexType(oldList.size(), newList.size(), [&](auto index) {
+            using Index = decltype(index);
+            Private::Buffers<Index> &buffers = m_buffers.template emplace<Private::Buffers<Index>>();
+            const Private::Slice<Index> slice = Private::trim<Index>(m_oldList, m_newList);
+            if (!slice.isNull()) {
+                buffers.slices.push_back(slice);
+            }
+            m_costLimit = Private::costLimit(options, costLimit, slice);
+        });
+    }
+
+    DiffRange(const DiffRange &) = delete;
+    DiffRange &operator=(const DiffRange &) = delete;
+
+    /**
+     * Returns an iterator pointing to the first edit operation that hasn't been visited yet.
+     */
+    iterator begin()
+    {
+        if (!m_started) {
+            m_started = true;
+            advance();
+        }
+        return iterator(this);
+    }
+
+    /**
+     * Returns an iterator pointing past the last edit operation.
+     */
+    iterator end()
+    {
+        return iterator();
+    }
+
+private:
+    void advance()
+    {
+        std::visit([this](auto &buffers) {
+            using Index = std::decay_t<decltype(buffers.slices.front().x1)>;
+            Private::Snake<Index> snake;
+            if (Private::nextSnake(buffers, m_oldList, m_newList, Index(m_costLimit), snake)) {
+                const auto store = [this](const EditOperation &operation) {
+                    m_current = operation;
+                };
+                Private::emitSnake(snake, store);
+            } else {
+                m_finished = true;
+            }
+        }, m_buffers);
+    }
+
+    const Container &m_oldList;
+    const Container &m_newList;
+    std::variant<Private::Buffers<qint32>, Private::Buffers<qsizetype>> m_buffers;
+    qsizetype m_costLimit = 0;
+    EditOperation m_current;
+    bool m_started = false;
+    bool m_finished = false;
+};
 
 } // namespace differ